@@ -0,0 +1,60 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua.bench;
+
+// Many short-lived small tables and strings, which is where the pool allocator is supposed to help
+static constexpr const char *CHURN_SCRIPT = R"(
+function bench_churn()
+	local objects = {}
+	for i = 1, 1000 do
+		objects[i] = {x = i, y = i * 2, name = "object_" .. i}
+	end
+	return #objects
+end
+)";
+
+static void run_churn(Lua::bench::Run &run, lua_State *l)
+{
+	std::string err;
+	if(Lua::RunString(l, CHURN_SCRIPT, "bench", err) != Lua::StatusCode::Ok) {
+		run.Skip(err);
+		return;
+	}
+	run.SetItemsPerIteration(1000);
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			lua_getglobal(l, "bench_churn");
+			lua_call(l, 0, 1);
+			lua_settop(l, 0);
+		}
+	});
+}
+
+static void bench_churn_default(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	run_churn(run, l);
+}
+
+static void bench_churn_pool(Lua::bench::Run &run)
+{
+	Lua::PoolAllocator allocator {};
+	auto *l = Lua::CreateState(allocator);
+	if(l == nullptr) {
+		run.Skip("the lua runtime doesn't support custom allocators");
+		return;
+	}
+	run_churn(run, l);
+	Lua::CloseState(l);
+}
+
+void Lua::bench::register_allocator_benchmarks()
+{
+	register_benchmark("allocator/table_churn_default", bench_churn_default);
+	register_benchmark("allocator/table_churn_pool", bench_churn_pool);
+}
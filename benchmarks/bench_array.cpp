@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua.bench;
+
+static constexpr size_t ELEMENT_COUNT = 1'000'000;
+
+static std::vector<float> get_values()
+{
+	std::vector<float> values;
+	values.resize(ELEMENT_COUNT);
+	for(size_t i = 0; i < values.size(); ++i)
+		values[i] = static_cast<float>(i) * 0.5f;
+	return values;
+}
+
+static void bench_push_array(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	auto values = get_values();
+	run.SetItemsPerIteration(static_cast<double>(ELEMENT_COUNT));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			Lua::PushArray(l, values);
+			lua_settop(l, 0);
+		}
+	});
+}
+
+static void bench_push_array_cdata(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	auto values = get_values();
+	if(!Lua::PushArrayCData(l, values)) {
+		run.Skip("the FFI is not available");
+		return;
+	}
+	lua_settop(l, 0);
+	run.SetItemsPerIteration(static_cast<double>(ELEMENT_COUNT));
+	run.SetBytesPerIteration(static_cast<double>(ELEMENT_COUNT * sizeof(float)));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			Lua::PushArrayCData(l, values);
+			lua_settop(l, 0);
+		}
+	});
+}
+
+// Registers the memory and pushes a view of it without copying, then releases it again
+static void bench_push_array_view(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	Lua::BufferBridge bridge {l};
+	auto values = get_values();
+	auto handle = bridge.PushArrayView(l, std::span<const float> {values});
+	if(!bridge.IsValid(handle)) {
+		run.Skip("the FFI is not available");
+		return;
+	}
+	bridge.Release(handle);
+	lua_settop(l, 0);
+	run.SetItemsPerIteration(static_cast<double>(ELEMENT_COUNT));
+	run.SetBytesPerIteration(static_cast<double>(ELEMENT_COUNT * sizeof(float)));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			bridge.Release(bridge.PushArrayView(l, std::span<const float> {values}));
+			lua_settop(l, 0);
+		}
+	});
+}
+
+static void bench_to_array(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	Lua::PushArray(l, get_values());
+	std::vector<float> values;
+	run.SetItemsPerIteration(static_cast<double>(ELEMENT_COUNT));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::bench::do_not_optimize(Lua::ToArray(l, -1, values));
+	});
+}
+
+// Integral targets have to validate every element
+static void bench_to_array_int(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	std::vector<int32_t> source;
+	source.resize(ELEMENT_COUNT);
+	std::iota(source.begin(), source.end(), 0);
+	Lua::PushArray(l, source);
+	std::vector<int32_t> values;
+	run.SetItemsPerIteration(static_cast<double>(ELEMENT_COUNT));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::bench::do_not_optimize(Lua::ToArray(l, -1, values));
+	});
+}
+
+void Lua::bench::register_array_benchmarks()
+{
+	register_benchmark("array/push_array_1m", bench_push_array);
+	register_benchmark("array/push_array_cdata_1m", bench_push_array_cdata);
+	register_benchmark("array/push_array_view_1m", bench_push_array_view);
+	register_benchmark("array/to_array_1m", bench_to_array);
+	register_benchmark("array/to_array_int_1m", bench_to_array_int);
+}
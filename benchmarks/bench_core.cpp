@@ -0,0 +1,297 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua.bench;
+
+static void bench_push_number(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			Lua::Push<double>(l, 1.5);
+			lua_settop(l, 0);
+		}
+	});
+}
+
+static void bench_push_string(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	std::string value = "benchmark";
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			Lua::PushString(l, value);
+			lua_settop(l, 0);
+		}
+	});
+}
+
+static void bench_to_number(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	lua_pushnumber(l, 1.5);
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::bench::do_not_optimize(Lua::ToNumber(l, 1));
+	});
+}
+
+static void bench_to_string(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	lua_pushstring(l, "benchmark");
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::bench::do_not_optimize(Lua::ToString(l, 1));
+	});
+}
+
+static void bench_check_int(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	lua_pushinteger(l, 42);
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::bench::do_not_optimize(Lua::CheckInt(l, 1));
+	});
+}
+
+static void bench_check_string(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	lua_pushstring(l, "benchmark");
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::bench::do_not_optimize(Lua::CheckString(l, 1));
+	});
+}
+
+static int32_t traceback(lua_State *l)
+{
+	lua_getfield(l, LUA_GLOBALSINDEX, "debug");
+	lua_getfield(l, -1, "traceback");
+	lua_pushvalue(l, 1);
+	lua_pushinteger(l, 2);
+	lua_call(l, 2, 1);
+	return 1;
+}
+
+template<bool TTraceback>
+static void bench_protected_call(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	std::string err;
+	if(Lua::RunString(l, "function bench_identity(a) return a end", "bench", err) != Lua::StatusCode::Ok) {
+		run.Skip(err);
+		return;
+	}
+	auto pushArgs = [](lua_State *lua) {
+		lua_getglobal(lua, "bench_identity");
+		lua_pushinteger(lua, 1);
+		return Lua::StatusCode::Ok;
+	};
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			Lua::ProtectedCall(l, pushArgs, 1, err, TTraceback ? traceback : nullptr);
+			lua_settop(l, 0);
+		}
+	});
+}
+
+// The std::function overload, as used by code that stores its argument callbacks
+static void bench_protected_call_std_function(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	std::string err;
+	if(Lua::RunString(l, "function bench_identity(a) return a end", "bench", err) != Lua::StatusCode::Ok) {
+		run.Skip(err);
+		return;
+	}
+	const std::function<Lua::StatusCode(lua_State *)> pushArgs = [](lua_State *lua) {
+		lua_getglobal(lua, "bench_identity");
+		lua_pushinteger(lua, 1);
+		return Lua::StatusCode::Ok;
+	};
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			Lua::ProtectedCall(l, pushArgs, 1, err);
+			lua_settop(l, 0);
+		}
+	});
+}
+
+constexpr size_t LIBRARY_VALUE_COUNT = 64;
+
+static void bench_register_library_values_map(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	Lua::RegisterLibrary(l, "bench", std::vector<luaL_Reg> {});
+	std::unordered_map<std::string, lua_Integer> values;
+	for(size_t i = 0; i < LIBRARY_VALUE_COUNT; ++i)
+		values["VALUE_" + std::to_string(i)] = static_cast<lua_Integer>(i);
+	run.SetItemsPerIteration(LIBRARY_VALUE_COUNT);
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::RegisterLibraryValues(l, "bench", values);
+	});
+}
+
+static void bench_register_library_values_span(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	Lua::RegisterLibrary(l, "bench", std::vector<luaL_Reg> {});
+	std::vector<std::string> names;
+	std::vector<Lua::LibraryEnum> values;
+	names.reserve(LIBRARY_VALUE_COUNT);
+	for(size_t i = 0; i < LIBRARY_VALUE_COUNT; ++i)
+		names.push_back("VALUE_" + std::to_string(i));
+	for(size_t i = 0; i < LIBRARY_VALUE_COUNT; ++i)
+		values.push_back({names[i].c_str(), static_cast<lua_Integer>(i)});
+	run.SetItemsPerIteration(LIBRARY_VALUE_COUNT);
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::RegisterLibraryValues(l, "bench", std::span<const Lua::LibraryEnum> {values});
+	});
+}
+
+static int32_t library_function(lua_State *) { return 0; }
+static constexpr luaL_Reg LIBRARY_FUNCTIONS[] = {
+  {"f0", library_function},
+  {"f1", library_function},
+  {"f2", library_function},
+  {"f3", library_function},
+  {"f4", library_function},
+  {"f5", library_function},
+  {"f6", library_function},
+  {"f7", library_function},
+  {"f8", library_function},
+  {"f9", library_function},
+  {"f10", library_function},
+  {"f11", library_function},
+  {"f12", library_function},
+  {"f13", library_function},
+  {"f14", library_function},
+  {"f15", library_function},
+};
+
+static void bench_register_library_vector(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	std::vector<luaL_Reg> functions {std::begin(LIBRARY_FUNCTIONS), std::end(LIBRARY_FUNCTIONS)};
+	run.SetItemsPerIteration(static_cast<double>(functions.size()));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::RegisterLibrary(l, "bench", functions);
+	});
+}
+
+static void bench_register_library_span(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	run.SetItemsPerIteration(static_cast<double>(std::size(LIBRARY_FUNCTIONS)));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::register_library(l, "bench", LIBRARY_FUNCTIONS);
+	});
+}
+
+// Start-up of a state with a realistic set of libraries, as registered by a host application.
+// Each iteration creates the state, registers all libraries and closes the state again.
+constexpr size_t STARTUP_LIBRARY_COUNT = 16;
+constexpr size_t STARTUP_FUNCTION_COUNT = 32;
+constexpr size_t STARTUP_ENUM_COUNT = 48;
+
+namespace {
+	struct StartupLibraries {
+		StartupLibraries();
+		std::vector<std::string> libraryNames;
+		std::vector<std::string> names;
+		std::vector<luaL_Reg> functions;
+		std::vector<Lua::LibraryEnum> enums;
+		std::unordered_map<std::string, lua_Integer> enumMap;
+	};
+	StartupLibraries::StartupLibraries()
+	{
+		for(size_t i = 0; i < STARTUP_LIBRARY_COUNT; ++i)
+			libraryNames.push_back("bench_lib" + std::to_string(i));
+		names.reserve(STARTUP_FUNCTION_COUNT + STARTUP_ENUM_COUNT);
+		for(size_t i = 0; i < STARTUP_FUNCTION_COUNT; ++i)
+			names.push_back("Function" + std::to_string(i));
+		for(size_t i = 0; i < STARTUP_ENUM_COUNT; ++i)
+			names.push_back("ENUM_VALUE_" + std::to_string(i));
+		for(size_t i = 0; i < STARTUP_FUNCTION_COUNT; ++i)
+			functions.push_back({names[i].c_str(), library_function});
+		for(size_t i = 0; i < STARTUP_ENUM_COUNT; ++i) {
+			auto &name = names[STARTUP_FUNCTION_COUNT + i];
+			enums.push_back({name.c_str(), static_cast<lua_Integer>(i)});
+			enumMap[name] = static_cast<lua_Integer>(i);
+		}
+	}
+};
+
+static void bench_state_startup_vector(Lua::bench::Run &run)
+{
+	StartupLibraries libs {};
+	run.SetItemsPerIteration(static_cast<double>(STARTUP_LIBRARY_COUNT * (STARTUP_FUNCTION_COUNT + STARTUP_ENUM_COUNT)));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			Lua::bench::State l {};
+			for(auto &name : libs.libraryNames) {
+				Lua::RegisterLibrary(l, name, libs.functions);
+				Lua::RegisterLibraryEnums(l, name, libs.enumMap);
+			}
+		}
+	});
+}
+
+static void bench_state_startup_span(Lua::bench::Run &run)
+{
+	StartupLibraries libs {};
+	run.SetItemsPerIteration(static_cast<double>(STARTUP_LIBRARY_COUNT * (STARTUP_FUNCTION_COUNT + STARTUP_ENUM_COUNT)));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			Lua::bench::State l {};
+			for(auto &name : libs.libraryNames)
+				Lua::register_library(l, name, libs.functions, libs.enums);
+		}
+	});
+}
+
+static void bench_get_protected_table_value(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	lua_createtable(l, 0, 1);
+	lua_pushinteger(l, 42);
+	lua_setfield(l, -2, "value");
+	std::string key = "value";
+	run.Measure([&](uint64_t n) {
+		int32_t value = 0;
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::GetProtectedTableValue(l, 1, key, value);
+		Lua::bench::do_not_optimize(value);
+	});
+}
+
+void Lua::bench::register_core_benchmarks()
+{
+	register_benchmark("core/push_number", bench_push_number);
+	register_benchmark("core/push_string", bench_push_string);
+	register_benchmark("core/to_number", bench_to_number);
+	register_benchmark("core/to_string", bench_to_string);
+	register_benchmark("core/check_int", bench_check_int);
+	register_benchmark("core/check_string", bench_check_string);
+	register_benchmark("core/protected_call", bench_protected_call<false>);
+	register_benchmark("core/protected_call_traceback", bench_protected_call<true>);
+	register_benchmark("core/protected_call_std_function", bench_protected_call_std_function);
+	register_benchmark("core/register_library_values_map", bench_register_library_values_map);
+	register_benchmark("core/register_library_values_span", bench_register_library_values_span);
+	register_benchmark("core/register_library_vector", bench_register_library_vector);
+	register_benchmark("core/register_library_span", bench_register_library_span);
+	register_benchmark("core/state_startup_vector", bench_state_startup_vector);
+	register_benchmark("core/state_startup_span", bench_state_startup_span);
+	register_benchmark("core/get_protected_table_value", bench_get_protected_table_value);
+}
@@ -0,0 +1,124 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua.bench;
+
+static std::string generate_script(uint32_t functionCount)
+{
+	std::string source = "local M = {}\n";
+	for(uint32_t i = 0; i < functionCount; ++i) {
+		auto name = "f" + std::to_string(i);
+		source += "function M." + name + "(a, b)\n\tlocal t = {a = a, b = b, name = \"" + name + "\"}\n\tfor i = 1, 10 do t.a = t.a + i * b end\n\treturn t\nend\n";
+	}
+	return source + "return M\n";
+}
+
+static constexpr const char *LOAD_DIRECTORY = "bench/load";
+static constexpr const char *LOAD_SCRIPT = "script.lua";
+
+template<Lua::LoadMode TMode, bool TBytecodeCache>
+static void bench_load_file(Lua::bench::Run &run)
+{
+	Lua::bench::ScriptDirectory dir {LOAD_DIRECTORY};
+	Lua::bench::State l {};
+	auto source = generate_script(200);
+	if(!dir.WriteScript(LOAD_SCRIPT, source) || !dir.CompileScript(l, LOAD_SCRIPT)) {
+		run.Skip("unable to write " + dir.GetPath() + LOAD_SCRIPT);
+		return;
+	}
+	// The cache is measured with the source file, so it isn't shadowed by the precompiled one
+	if constexpr(TBytecodeCache)
+		Lua::set_precompiled_files_enabled(l, false);
+	auto &cache = Lua::BytecodeCache::Get();
+	auto cacheEnabled = cache.IsEnabled();
+	cache.SetEnabled(TBytecodeCache);
+	auto path = dir.GetPath() + LOAD_SCRIPT;
+	run.SetBytesPerIteration(static_cast<double>(source.size()));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			auto f = path;
+			Lua::LoadFile(l, f, fsys::SearchFlags::All, fsys::SearchFlags::None, TMode);
+			lua_settop(l, 0);
+		}
+	});
+	cache.SetEnabled(cacheEnabled);
+}
+
+static std::vector<std::string> get_include_paths(uint32_t count)
+{
+	std::vector<std::string> paths;
+	paths.reserve(count);
+	for(uint32_t i = 0; i < count; ++i)
+		paths.push_back("bench/include/module_" + std::to_string(i / 16) + "/script_" + std::to_string(i) + ".lua");
+	return paths;
+}
+
+static void bench_include_cache_contains(Lua::bench::Run &run)
+{
+	auto paths = get_include_paths(1024);
+	Lua::IncludeCache cache {};
+	for(auto &path : paths)
+		cache.Add(path);
+	// Look-ups usually don't use the normalized form
+	for(auto &path : paths)
+		std::replace(path.begin(), path.end(), '/', '\\');
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::bench::do_not_optimize(cache.Contains(paths[i % paths.size()]));
+	});
+}
+
+static void bench_include_cache_push_value(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	auto paths = get_include_paths(1024);
+	Lua::IncludeCache cache {};
+	for(auto &path : paths) {
+		lua_createtable(l, 0, 0);
+		cache.Add(l, path, -1);
+		lua_pop(l, 1);
+	}
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			cache.PushValue(l, paths[i % paths.size()]);
+			lua_settop(l, 0);
+		}
+	});
+	cache.Clear();
+}
+
+// Repeated includes of a file whose result has been cached
+static void bench_include_file_cached(Lua::bench::Run &run)
+{
+	Lua::bench::ScriptDirectory dir {"bench/include_file"};
+	if(!dir.WriteScript("module.lua", "return {value = 1}\n")) {
+		run.Skip("unable to write " + dir.GetPath() + "module.lua");
+		return;
+	}
+	Lua::bench::State l {};
+	Lua::IncludeCache cache {};
+	auto path = dir.GetPath() + "module.lua";
+	std::string err;
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			auto f = path;
+			Lua::IncludeFile(l, cache, f, err, true);
+			lua_settop(l, 0);
+		}
+	});
+	cache.Clear();
+}
+
+void Lua::bench::register_loading_benchmarks()
+{
+	register_benchmark("loading/load_file_text", bench_load_file<LoadMode::TextOnly, false>);
+	register_benchmark("loading/load_file_precompiled", bench_load_file<LoadMode::BinaryOnly, false>);
+	register_benchmark("loading/load_file_bytecode_cache", bench_load_file<LoadMode::Any, true>);
+	register_benchmark("loading/include_cache_contains", bench_include_cache_contains);
+	register_benchmark("loading/include_cache_push_value", bench_include_cache_push_value);
+	register_benchmark("loading/include_file_cached", bench_include_file_cached);
+}
@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua.bench;
+
+static constexpr uint32_t SCRIPT_COUNT = 10'000;
+static constexpr uint32_t SCRIPTS_PER_DIRECTORY = 100;
+
+// Mixed-case directory names, so the manifest has to query the file system with the original case
+static std::vector<std::string> write_scripts(const Lua::bench::ScriptDirectory &dir)
+{
+	std::vector<std::string> paths;
+	paths.reserve(SCRIPT_COUNT);
+	for(uint32_t i = 0; i < SCRIPT_COUNT; ++i) {
+		auto fileName = "Module_" + std::to_string(i / SCRIPTS_PER_DIRECTORY) + "/script_" + std::to_string(i) + ".lua";
+		if(!dir.WriteScript(fileName, "return " + std::to_string(i) + "\n"))
+			return {};
+		paths.push_back(dir.GetPath() + fileName);
+	}
+	return paths;
+}
+
+// Resolving and loading scripts from a large script directory, with and without the manifest
+template<bool TManifest>
+static void bench_load_file(Lua::bench::Run &run)
+{
+	Lua::bench::ScriptDirectory dir {"bench/manifest"};
+	auto paths = write_scripts(dir);
+	if(paths.empty()) {
+		run.Skip("unable to write scripts to " + dir.GetPath());
+		return;
+	}
+	Lua::bench::State l {};
+	auto &manifest = Lua::ScriptManifest::Get();
+	auto manifestEnabled = manifest.IsEnabled();
+	manifest.SetEnabled(TManifest);
+	// Indexes all directories up front
+	for(auto &path : paths) {
+		auto f = path;
+		Lua::LoadFile(l, f);
+		lua_settop(l, 0);
+	}
+	run.Measure([&](uint64_t n) {
+		// Strided, so consecutive look-ups hit different directories
+		for(uint64_t i = 0; i < n; ++i) {
+			auto f = paths[(i * 7919) % paths.size()];
+			Lua::LoadFile(l, f);
+			lua_settop(l, 0);
+		}
+	});
+	manifest.SetEnabled(manifestEnabled);
+}
+
+void Lua::bench::register_manifest_benchmarks()
+{
+	register_benchmark("manifest/load_file_10k_scripts", bench_load_file<false>);
+	register_benchmark("manifest/load_file_10k_scripts_manifest", bench_load_file<true>);
+}
@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua.bench;
+
+// Large table of nested records with mixed keys and values, roughly what save games or network messages look like
+static constexpr const char *NESTED_SCRIPT = R"(
+local root = {}
+for i = 1, 10000 do
+	root[i] = {
+		id = i,
+		name = "entity_" .. i,
+		active = (i % 2) == 0,
+		pos = {x = i * 0.5, y = i * 0.25, z = -i},
+		tags = {"a", "b", "tag_" .. (i % 16)},
+		stats = {health = 100, armor = i % 50, ammo = {9, 18, 27}},
+	}
+end
+return root
+)";
+
+// Flat array of numbers, which is dominated by the per-value overhead of the format
+static constexpr const char *ARRAY_SCRIPT = R"(
+local root = {}
+for i = 1, 100000 do
+	root[i] = i * 0.5
+end
+return root
+)";
+
+static bool push_data(Lua::bench::Run &run, lua_State *l, const char *script)
+{
+	std::string err;
+	if(Lua::RunString(l, script, 1, "bench", err) != Lua::StatusCode::Ok) {
+		run.Skip(err);
+		return false;
+	}
+	return true;
+}
+
+template<const char *const &TScript>
+static void bench_encode(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	if(!push_data(run, l, TScript))
+		return;
+	Lua::ValueSerializer serializer {};
+	auto data = serializer.Encode(l, -1);
+	if(data.empty()) {
+		run.Skip(serializer.GetError());
+		return;
+	}
+	run.SetBytesPerIteration(static_cast<double>(data.size()));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::bench::do_not_optimize(serializer.Encode(l, -1).size());
+	});
+}
+
+// Decodes into a different state than the one that encoded the data, which is the common use case
+template<const char *const &TScript>
+static void bench_decode(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	if(!push_data(run, l, TScript))
+		return;
+	Lua::ValueSerializer serializer {};
+	auto encoded = serializer.Encode(l, -1);
+	if(encoded.empty()) {
+		run.Skip(serializer.GetError());
+		return;
+	}
+	std::vector<uint8_t> data {encoded.begin(), encoded.end()};
+	Lua::bench::State target {};
+	run.SetBytesPerIteration(static_cast<double>(data.size()));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			Lua::bench::do_not_optimize(serializer.Decode(target, data));
+			lua_settop(target, 0);
+		}
+	});
+}
+
+void Lua::bench::register_serializer_benchmarks()
+{
+	register_benchmark("serializer/encode_nested_tables", bench_encode<NESTED_SCRIPT>);
+	register_benchmark("serializer/decode_nested_tables", bench_decode<NESTED_SCRIPT>);
+	register_benchmark("serializer/encode_number_array", bench_encode<ARRAY_SCRIPT>);
+	register_benchmark("serializer/decode_number_array", bench_decode<ARRAY_SCRIPT>);
+}
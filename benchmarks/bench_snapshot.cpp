@@ -0,0 +1,76 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua.bench;
+
+// Graph of nested tables with string keys, functions and closures
+static constexpr const char *SNAPSHOT_SCRIPT = R"(
+bench_root = {}
+for i = 1, 1000 do
+	local t = {id = i, name = "object_" .. i, children = {}}
+	for j = 1, 8 do
+		t.children[j] = {value = j, parent = t}
+	end
+	t.update = function(dt) return t.id * dt end
+	bench_root[i] = t
+end
+)";
+
+static void bench_snapshot(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	std::string err;
+	if(Lua::RunString(l, SNAPSHOT_SCRIPT, "bench", err) != Lua::StatusCode::Ok) {
+		run.Skip(err);
+		return;
+	}
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			lua_pushcfunction(l, lua::snapshot);
+			lua_pcall(l, 0, 1, 0);
+			lua_settop(l, 0);
+		}
+	});
+}
+
+static void bench_heap_snapshot_capture(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	std::string err;
+	if(Lua::RunString(l, SNAPSHOT_SCRIPT, "bench", err) != Lua::StatusCode::Ok) {
+		run.Skip(err);
+		return;
+	}
+	run.SetItemsPerIteration(static_cast<double>(lua::HeapSnapshot::Capture(l).objects.size()));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::bench::do_not_optimize(lua::HeapSnapshot::Capture(l).objects.size());
+	});
+}
+
+static void bench_heap_snapshot_retained_sizes(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	std::string err;
+	if(Lua::RunString(l, SNAPSHOT_SCRIPT, "bench", err) != Lua::StatusCode::Ok) {
+		run.Skip(err);
+		return;
+	}
+	auto snapshot = lua::HeapSnapshot::Capture(l);
+	run.SetItemsPerIteration(static_cast<double>(snapshot.objects.size()));
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			snapshot.ComputeRetainedSizes();
+	});
+}
+
+void Lua::bench::register_snapshot_benchmarks()
+{
+	register_benchmark("snapshot/snapshot", bench_snapshot);
+	register_benchmark("snapshot/heap_snapshot_capture", bench_heap_snapshot_capture);
+	register_benchmark("snapshot/heap_snapshot_retained_sizes", bench_heap_snapshot_retained_sizes);
+}
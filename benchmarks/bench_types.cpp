@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua.bench;
+
+namespace {
+	struct BenchBase {
+		virtual ~BenchBase() = default;
+		int32_t value = 0;
+	};
+	struct BenchDerived : public BenchBase {};
+};
+
+static void register_classes(lua_State *l)
+{
+	luabind::module(l)[luabind::class_<BenchBase>("BenchBase").def(luabind::constructor<>()), luabind::class_<BenchDerived, BenchBase>("BenchDerived").def(luabind::constructor<>())];
+}
+
+// Type checks as done by the Is/Check functions generated by LUA_REGISTER_TYPE (the macro itself is not exported by the module),
+// reported as checks per second
+template<typename TValue>
+static void bench_is_type(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	register_classes(l);
+	luabind::object(l, TValue {}).push(l);
+	run.SetItemsPerIteration(1);
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::bench::do_not_optimize(Lua::get_registered_instance<BenchBase>(l, 1) != nullptr);
+	});
+}
+
+// Values that aren't instances at all, e.g. when an overload is picked based on the argument type
+static void bench_is_type_mismatch(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	register_classes(l);
+	lua_newtable(l);
+	run.SetItemsPerIteration(1);
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i)
+			Lua::bench::do_not_optimize(Lua::get_registered_instance<BenchBase>(l, 1) != nullptr);
+	});
+}
+
+// Baseline: The generic conversion through a luabind::object, which get_registered_instance replaces
+static void bench_object_cast(Lua::bench::Run &run)
+{
+	Lua::bench::State l {};
+	register_classes(l);
+	luabind::object(l, BenchDerived {}).push(l);
+	run.SetItemsPerIteration(1);
+	run.Measure([&](uint64_t n) {
+		for(uint64_t i = 0; i < n; ++i) {
+			luabind::object o {luabind::from_stack(l, 1)};
+			Lua::bench::do_not_optimize(luabind::object_cast_nothrow<BenchBase *>(o) != boost::none);
+		}
+	});
+}
+
+void Lua::bench::register_type_benchmarks()
+{
+	register_benchmark("types/is_type_exact", bench_is_type<BenchBase>);
+	register_benchmark("types/is_type_derived", bench_is_type<BenchDerived>);
+	register_benchmark("types/is_type_mismatch", bench_is_type_mismatch);
+	register_benchmark("types/object_cast_derived", bench_object_cast);
+}
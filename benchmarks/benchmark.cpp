@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua.bench;
+
+static std::vector<Lua::bench::Benchmark> &get_registry()
+{
+	static std::vector<Lua::bench::Benchmark> benchmarks;
+	return benchmarks;
+}
+
+void Lua::bench::register_benchmark(std::string name, BenchmarkFunction func) { get_registry().push_back({std::move(name), func}); }
+
+std::vector<Lua::bench::Benchmark> Lua::bench::get_benchmarks()
+{
+	auto benchmarks = get_registry();
+	std::sort(benchmarks.begin(), benchmarks.end(), [](const Benchmark &a, const Benchmark &b) { return a.name < b.name; });
+	return benchmarks;
+}
+
+Lua::bench::Run::Run(const Settings &settings, Result &result) : m_settings {settings}, m_result {result} {}
+
+void Lua::bench::Run::SetItemsPerIteration(double items) { m_itemsPerIteration = items; }
+void Lua::bench::Run::SetBytesPerIteration(double bytes) { m_bytesPerIteration = bytes; }
+void Lua::bench::Run::Skip(std::string reason) { m_result.skipReason = std::move(reason); }
+
+static std::chrono::nanoseconds time_iterations(Lua::FunctionRef<void(uint64_t)> func, uint64_t n)
+{
+	auto t = std::chrono::steady_clock::now();
+	func(n);
+	return std::chrono::steady_clock::now() - t;
+}
+
+void Lua::bench::Run::Measure(FunctionRef<void(uint64_t)> func)
+{
+	constexpr uint64_t MAX_ITERATIONS = 1'000'000'000;
+	auto repetitions = std::max<uint32_t>(m_settings.repetitions, 1);
+	auto targetTime = std::chrono::duration_cast<std::chrono::nanoseconds>(m_settings.minTime) / repetitions;
+
+	// Also serves as warm-up
+	uint64_t n = 1;
+	auto t = time_iterations(func, n);
+	while(t < targetTime && n < MAX_ITERATIONS) {
+		// Aim slightly past the target, but grow by at most 10x per step in case the first runs were unusually fast
+		auto estimate = static_cast<double>(n) * 1.2 * static_cast<double>(targetTime.count()) / static_cast<double>(std::max<int64_t>(t.count(), 1));
+		n = std::clamp<uint64_t>(static_cast<uint64_t>(estimate), n + 1, std::min(n * 10, MAX_ITERATIONS));
+		t = time_iterations(func, n);
+	}
+
+	std::vector<double> samples;
+	samples.reserve(repetitions);
+	for(uint32_t i = 0; i < repetitions; ++i)
+		samples.push_back(static_cast<double>(time_iterations(func, n).count()) / static_cast<double>(n));
+	std::sort(samples.begin(), samples.end());
+
+	m_result.iterations = n;
+	m_result.nsPerOp = samples[samples.size() / 2];
+	m_result.nsPerOpMin = samples.front();
+	auto opsPerSecond = (m_result.nsPerOp > 0.0) ? (1'000'000'000.0 / m_result.nsPerOp) : 0.0;
+	m_result.itemsPerSecond = m_itemsPerIteration * opsPerSecond;
+	m_result.bytesPerSecond = m_bytesPerIteration * opsPerSecond;
+}
+
+Lua::bench::State::State() : m_state {CreateState()} { luabind::open(m_state); }
+Lua::bench::State::~State() { CloseState(m_state); }
+
+Lua::bench::ScriptDirectory::ScriptDirectory(std::string name) : m_path {std::move(name)}
+{
+	if(!m_path.empty() && m_path.back() != '/')
+		m_path += '/';
+	FileManager::CreatePath((SCRIPT_DIRECTORY_SLASH + m_path).c_str());
+}
+
+Lua::bench::ScriptDirectory::~ScriptDirectory()
+{
+	std::error_code ec;
+	std::filesystem::remove_all(std::filesystem::path {FileManager::GetProgramPath()} / SCRIPT_DIRECTORY / m_path, ec);
+}
+
+bool Lua::bench::ScriptDirectory::WriteScript(const std::string &fileName, const std::string_view &source) const
+{
+	auto path = SCRIPT_DIRECTORY_SLASH + m_path + fileName;
+	FileManager::CreatePath(ufile::get_path_from_filename(path).c_str());
+	auto f = FileManager::OpenFile<VFilePtrReal>(path.c_str(), "wb");
+	if(f == nullptr)
+		return false;
+	return f->Write(source.data(), source.size()) == source.size();
+}
+
+bool Lua::bench::ScriptDirectory::CompileScript(lua_State *l, const std::string &fileName) const
+{
+	auto path = m_path + fileName;
+	if(LoadFile(l, path, fsys::SearchFlags::All, fsys::SearchFlags::None, LoadMode::TextOnly) != StatusCode::Ok) {
+		lua_pop(l, 1);
+		return false;
+	}
+	auto outPath = SCRIPT_DIRECTORY_SLASH + m_path + fileName.substr(0, fileName.length() - DOT_FILE_EXTENSION.length()) + DOT_FILE_EXTENSION_PRECOMPILED;
+	// compile_file only pops the function if it fails
+	if(!compile_file(l, outPath))
+		return false;
+	lua_pop(l, 1);
+	return true;
+}
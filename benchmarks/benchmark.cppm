@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua.bench;
+
+export import pragma.lua;
+
+export namespace Lua::bench {
+	struct Result {
+		std::string name;
+		uint64_t iterations = 0;
+		// Median and fastest of all repetitions
+		double nsPerOp = 0.0;
+		double nsPerOpMin = 0.0;
+		// Throughput, 0 if the benchmark doesn't report it
+		double itemsPerSecond = 0.0;
+		double bytesPerSecond = 0.0;
+		std::string skipReason;
+	};
+
+	struct Settings {
+		std::chrono::milliseconds minTime {250};
+		uint32_t repetitions = 5;
+	};
+
+	class Run {
+	  public:
+		Run(const Settings &settings, Result &result);
+		// Calls 'func(n)' with an increasing iteration count until a call takes long enough to be measured reliably,
+		// then times the configured number of repetitions. Everything outside of 'func' is not measured.
+		void Measure(FunctionRef<void(uint64_t)> func);
+		// Number of processed items or bytes per iteration, used to report the throughput
+		void SetItemsPerIteration(double items);
+		void SetBytesPerIteration(double bytes);
+		// Marks the benchmark as not applicable to this build (e.g. without LuaJIT)
+		void Skip(std::string reason);
+	  private:
+		const Settings &m_settings;
+		Result &m_result;
+		double m_itemsPerIteration = 0.0;
+		double m_bytesPerIteration = 0.0;
+	};
+
+	using BenchmarkFunction = void (*)(Run &);
+	void register_benchmark(std::string name, BenchmarkFunction func);
+	struct Benchmark {
+		std::string name;
+		BenchmarkFunction func;
+	};
+	// Sorted by name, so the output order is stable between runs
+	std::vector<Benchmark> get_benchmarks();
+
+	// Prevents the compiler from discarding a value that is computed but otherwise unused
+	template<typename T>
+	void do_not_optimize(const T &value)
+	{
+		static_cast<void>(*static_cast<const volatile char *>(static_cast<const volatile void *>(std::addressof(value))));
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+	}
+
+	// Lua state with the standard libraries and luabind, closed on destruction
+	class State {
+	  public:
+		State();
+		State(const State &) = delete;
+		State &operator=(const State &) = delete;
+		~State();
+		lua_State *Get() const { return m_state; }
+		operator lua_State *() const { return m_state; }
+	  private:
+		lua_State *m_state = nullptr;
+	};
+
+	// Temporary directory below SCRIPT_DIRECTORY for generated scripts. Removed on destruction.
+	class ScriptDirectory {
+	  public:
+		// 'name' is relative to SCRIPT_DIRECTORY
+		ScriptDirectory(std::string name);
+		ScriptDirectory(const ScriptDirectory &) = delete;
+		ScriptDirectory &operator=(const ScriptDirectory &) = delete;
+		~ScriptDirectory();
+		// Path relative to SCRIPT_DIRECTORY, e.g. "bench/load/"
+		const std::string &GetPath() const { return m_path; }
+		// Writes a script, 'fileName' is relative to this directory. Returns false if the file couldn't be written.
+		bool WriteScript(const std::string &fileName, const std::string_view &source) const;
+		// Compiles a script that has been written with WriteScript to a precompiled file next to it
+		bool CompileScript(lua_State *l, const std::string &fileName) const;
+	  private:
+		std::string m_path;
+	};
+
+	void register_allocator_benchmarks();
+	void register_array_benchmarks();
+	void register_core_benchmarks();
+	void register_loading_benchmarks();
+	void register_manifest_benchmarks();
+	void register_serializer_benchmarks();
+	void register_snapshot_benchmarks();
+	void register_type_benchmarks();
+};
@@ -0,0 +1,263 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+#include "lua_headers.hpp"
+
+import pragma.lua.bench;
+
+// Version of the output format, increased whenever fields are renamed or their meaning changes
+static constexpr uint32_t FORMAT_VERSION = 1;
+
+enum class OutputFormat : uint8_t {
+	Json = 0,
+	Csv,
+};
+
+struct Options {
+	std::string filter;
+	OutputFormat format = OutputFormat::Json;
+	std::string outputPath;
+	std::string baselinePath;
+	Lua::bench::Settings settings {};
+	bool list = false;
+};
+
+static void print_usage()
+{
+	std::fputs("Usage: luasystem_bench [options]\n"
+	           "  --filter <text>      Only run benchmarks whose name contains the text\n"
+	           "  --format <json|csv>  Output format (default: json)\n"
+	           "  --output <path>      Write the results to a file instead of stdout\n"
+	           "  --baseline <path>    Compare against the results of a previous run (json or csv)\n"
+	           "  --min-time <ms>      Minimum measured time per benchmark (default: 250)\n"
+	           "  --repetitions <n>    Number of measured repetitions, the median is reported (default: 5)\n"
+	           "  --list               List all benchmarks and exit\n",
+	  stderr);
+}
+
+static std::optional<Options> parse_options(int argc, char *argv[])
+{
+	Options options {};
+	for(int i = 1; i < argc; ++i) {
+		std::string_view arg = argv[i];
+		auto next = [&]() -> const char * { return (i + 1 < argc) ? argv[++i] : nullptr; };
+		if(arg == "--list")
+			options.list = true;
+		else if(arg == "--filter" || arg == "--format" || arg == "--output" || arg == "--baseline" || arg == "--min-time" || arg == "--repetitions") {
+			auto *value = next();
+			if(value == nullptr) {
+				std::fprintf(stderr, "Missing value for %s\n", argv[i]);
+				return {};
+			}
+			if(arg == "--filter")
+				options.filter = value;
+			else if(arg == "--format") {
+				std::string_view format = value;
+				if(format == "json")
+					options.format = OutputFormat::Json;
+				else if(format == "csv")
+					options.format = OutputFormat::Csv;
+				else {
+					std::fprintf(stderr, "Unknown format '%s'\n", value);
+					return {};
+				}
+			}
+			else if(arg == "--output")
+				options.outputPath = value;
+			else if(arg == "--baseline")
+				options.baselinePath = value;
+			else if(arg == "--min-time")
+				options.settings.minTime = std::chrono::milliseconds {std::strtoul(value, nullptr, 10)};
+			else
+				options.settings.repetitions = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		}
+		else {
+			print_usage();
+			return {};
+		}
+	}
+	return options;
+}
+
+static std::string escape_json(const std::string_view &str)
+{
+	std::string escaped;
+	escaped.reserve(str.size());
+	for(auto c : str) {
+		switch(c) {
+		case '"':
+			escaped += "\\\"";
+			break;
+		case '\\':
+			escaped += "\\\\";
+			break;
+		case '\n':
+			escaped += "\\n";
+			break;
+		case '\t':
+			escaped += "\\t";
+			break;
+		default:
+			if(static_cast<unsigned char>(c) < 0x20)
+				escaped += std::format("\\u{:04x}", static_cast<unsigned char>(c));
+			else
+				escaped += c;
+			break;
+		}
+	}
+	return escaped;
+}
+
+static std::string escape_csv(const std::string_view &str)
+{
+	if(str.find_first_of(",\"\n") == std::string_view::npos)
+		return std::string {str};
+	std::string escaped = "\"";
+	for(auto c : str) {
+		if(c == '"')
+			escaped += '"';
+		escaped += c;
+	}
+	return escaped + '"';
+}
+
+// One benchmark per line, so results of different releases can be compared with a plain diff
+static std::string format_json(const std::vector<Lua::bench::Result> &results)
+{
+	std::string out = "{\n";
+	out += std::format("\t\"format_version\": {},\n", FORMAT_VERSION);
+	out += std::format("\t\"lua_version\": \"{}\",\n", escape_json(LUA_VERSION));
+#ifdef USE_LUAJIT
+	out += "\t\"luajit\": true,\n";
+#else
+	out += "\t\"luajit\": false,\n";
+#endif
+	out += std::format("\t\"metrics\": {},\n", Lua::METRICS_ENABLED ? "true" : "false");
+	out += "\t\"benchmarks\": [\n";
+	for(size_t i = 0; i < results.size(); ++i) {
+		auto &result = results[i];
+		if(!result.skipReason.empty())
+			out += std::format("\t\t{{\"name\": \"{}\", \"skipped\": \"{}\"}}", escape_json(result.name), escape_json(result.skipReason));
+		else
+			out += std::format("\t\t{{\"name\": \"{}\", \"iterations\": {}, \"ns_per_op\": {:.3f}, \"ns_per_op_min\": {:.3f}, \"items_per_second\": {:.1f}, \"bytes_per_second\": {:.1f}}}", escape_json(result.name), result.iterations, result.nsPerOp,
+			  result.nsPerOpMin, result.itemsPerSecond, result.bytesPerSecond);
+		out += (i + 1 < results.size()) ? ",\n" : "\n";
+	}
+	out += "\t]\n}\n";
+	return out;
+}
+
+static std::string format_csv(const std::vector<Lua::bench::Result> &results)
+{
+	std::string out = "name,iterations,ns_per_op,ns_per_op_min,items_per_second,bytes_per_second,skipped\n";
+	for(auto &result : results) {
+		if(!result.skipReason.empty())
+			out += std::format("{},,,,,,{}\n", escape_csv(result.name), escape_csv(result.skipReason));
+		else
+			out += std::format("{},{},{:.3f},{:.3f},{:.1f},{:.1f},\n", escape_csv(result.name), result.iterations, result.nsPerOp, result.nsPerOpMin, result.itemsPerSecond, result.bytesPerSecond);
+	}
+	return out;
+}
+
+// Reads the median time per operation of every benchmark from a file written by a previous run
+static std::optional<std::unordered_map<std::string, double>> load_baseline(const std::string &path)
+{
+	std::ifstream f {path};
+	if(!f)
+		return {};
+	std::unordered_map<std::string, double> baseline;
+	std::string line;
+	while(std::getline(f, line)) {
+		std::string_view view = line;
+		auto nameStart = view.find("\"name\": \"");
+		if(nameStart != std::string_view::npos) {
+			// json
+			nameStart += 9;
+			auto nameEnd = view.find('"', nameStart);
+			auto valueStart = view.find("\"ns_per_op\": ");
+			if(nameEnd == std::string_view::npos || valueStart == std::string_view::npos)
+				continue;
+			baseline[std::string {view.substr(nameStart, nameEnd - nameStart)}] = std::strtod(line.c_str() + valueStart + 13, nullptr);
+			continue;
+		}
+		// csv
+		auto sep0 = view.find(',');
+		auto sep1 = (sep0 != std::string_view::npos) ? view.find(',', sep0 + 1) : std::string_view::npos;
+		if(sep1 == std::string_view::npos || sep1 + 1 >= view.size() || view.substr(0, sep0) == "name" || view[sep1 + 1] == ',')
+			continue;
+		baseline[std::string {view.substr(0, sep0)}] = std::strtod(line.c_str() + sep1 + 1, nullptr);
+	}
+	return baseline;
+}
+
+static void print_comparison(const std::vector<Lua::bench::Result> &results, const std::unordered_map<std::string, double> &baseline)
+{
+	std::fprintf(stderr, "\n%-56s %14s %14s %9s\n", "benchmark", "baseline ns", "current ns", "change");
+	for(auto &result : results) {
+		auto it = baseline.find(result.name);
+		if(!result.skipReason.empty() || it == baseline.end() || it->second <= 0.0)
+			continue;
+		auto change = (result.nsPerOp / it->second - 1.0) * 100.0;
+		std::fprintf(stderr, "%-56s %14.3f %14.3f %+8.1f%%\n", result.name.c_str(), it->second, result.nsPerOp, change);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	auto options = parse_options(argc, argv);
+	if(!options)
+		return 1;
+
+	Lua::bench::register_allocator_benchmarks();
+	Lua::bench::register_array_benchmarks();
+	Lua::bench::register_core_benchmarks();
+	Lua::bench::register_loading_benchmarks();
+	Lua::bench::register_manifest_benchmarks();
+	Lua::bench::register_serializer_benchmarks();
+	Lua::bench::register_snapshot_benchmarks();
+	Lua::bench::register_type_benchmarks();
+
+	auto benchmarks = Lua::bench::get_benchmarks();
+	std::erase_if(benchmarks, [&options](const Lua::bench::Benchmark &benchmark) { return benchmark.name.find(options->filter) == std::string::npos; });
+	if(options->list) {
+		for(auto &benchmark : benchmarks)
+			std::printf("%s\n", benchmark.name.c_str());
+		return 0;
+	}
+
+	std::optional<std::unordered_map<std::string, double>> baseline {};
+	if(!options->baselinePath.empty()) {
+		baseline = load_baseline(options->baselinePath);
+		if(!baseline) {
+			std::fprintf(stderr, "Unable to read baseline '%s'\n", options->baselinePath.c_str());
+			return 1;
+		}
+	}
+
+	std::vector<Lua::bench::Result> results;
+	results.reserve(benchmarks.size());
+	for(auto &benchmark : benchmarks) {
+		auto &result = results.emplace_back();
+		result.name = benchmark.name;
+		Lua::bench::Run run {options->settings, result};
+		benchmark.func(run);
+		if(!result.skipReason.empty())
+			std::fprintf(stderr, "%-56s skipped: %s\n", result.name.c_str(), result.skipReason.c_str());
+		else
+			std::fprintf(stderr, "%-56s %14.3f ns/op\n", result.name.c_str(), result.nsPerOp);
+	}
+
+	auto out = (options->format == OutputFormat::Csv) ? format_csv(results) : format_json(results);
+	if(options->outputPath.empty())
+		std::fputs(out.c_str(), stdout);
+	else {
+		std::ofstream f {options->outputPath, std::ios::binary};
+		if(!f.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+			std::fprintf(stderr, "Unable to write '%s'\n", options->outputPath.c_str());
+			return 1;
+		}
+	}
+	if(baseline)
+		print_comparison(results, *baseline);
+	return 0;
+}
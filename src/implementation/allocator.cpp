@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :core;
+import :allocator;
+
+void *Lua::PoolAllocator::Allocate(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	auto &allocator = *static_cast<PoolAllocator *>(ud);
+	// Lua always passes the original block size for existing blocks, so no block headers are required
+	if(ptr == nullptr)
+		osize = 0;
+	auto &stats = allocator.m_stats;
+	if(nsize == 0) {
+		if(ptr)
+			allocator.FreeBlock(ptr, osize);
+		stats.liveBytes -= osize;
+		return nullptr;
+	}
+	auto *p = (ptr == nullptr) ? allocator.AllocateBlock(nsize) : allocator.Reallocate(ptr, osize, nsize);
+	if(p == nullptr)
+		return nullptr;
+	stats.liveBytes = stats.liveBytes - osize + nsize;
+	stats.peakBytes = std::max(stats.peakBytes, stats.liveBytes);
+	++stats.allocationCount;
+	return p;
+}
+
+Lua::PoolAllocator::~PoolAllocator()
+{
+	for(auto *page : m_pages)
+		std::free(page);
+}
+
+const Lua::PoolAllocator::Stats &Lua::PoolAllocator::GetStats() const { return m_stats; }
+
+void *Lua::PoolAllocator::AllocateBlock(size_t size)
+{
+	if(!IsSmallBlock(size)) {
+		++m_stats.largeAllocationCount;
+		return std::malloc(size);
+	}
+	auto &sizeClass = m_sizeClasses[GetSizeClassIndex(size)];
+	if(sizeClass.freeList) {
+		auto *block = sizeClass.freeList;
+		sizeClass.freeList = block->next;
+		return block;
+	}
+	auto blockSize = (GetSizeClassIndex(size) + 1) * SIZE_CLASS_GRANULARITY;
+	if(sizeClass.bumpPtr == nullptr || static_cast<size_t>(sizeClass.bumpEnd - sizeClass.bumpPtr) < blockSize) {
+		auto *page = static_cast<char *>(std::malloc(PAGE_SIZE));
+		if(page == nullptr)
+			return nullptr;
+		m_pages.push_back(page);
+		m_stats.reservedPageBytes += PAGE_SIZE;
+		sizeClass.bumpPtr = page;
+		sizeClass.bumpEnd = page + PAGE_SIZE;
+	}
+	auto *block = sizeClass.bumpPtr;
+	sizeClass.bumpPtr += blockSize;
+	return block;
+}
+
+void Lua::PoolAllocator::FreeBlock(void *ptr, size_t size)
+{
+	if(!IsSmallBlock(size)) {
+		std::free(ptr);
+		return;
+	}
+	auto &sizeClass = m_sizeClasses[GetSizeClassIndex(size)];
+	auto *block = static_cast<FreeListNode *>(ptr);
+	block->next = sizeClass.freeList;
+	sizeClass.freeList = block;
+}
+
+void *Lua::PoolAllocator::Reallocate(void *ptr, size_t osize, size_t nsize)
+{
+	auto oSmall = IsSmallBlock(osize);
+	auto nSmall = IsSmallBlock(nsize);
+	// Lua assumes that shrinking a block can't fail, so the original block is kept if no new one can be obtained.
+	// It will be freed with the new size later on, which places it in the free list of a smaller size class (or, if it
+	// was allocated with malloc, means that it is never returned to the system), but is otherwise safe.
+	auto isShrink = nsize <= osize;
+	if(!oSmall && !nSmall) {
+		auto *newPtr = std::realloc(ptr, nsize);
+		return (newPtr == nullptr && isShrink) ? ptr : newPtr;
+	}
+	if(oSmall && nSmall && GetSizeClassIndex(osize) == GetSizeClassIndex(nsize))
+		return ptr; // Block is large enough already
+	auto *newPtr = AllocateBlock(nsize);
+	if(newPtr == nullptr)
+		return isShrink ? ptr : nullptr; // Lua expects the original block to remain valid on failure
+	std::memcpy(newPtr, ptr, std::min(osize, nsize));
+	FreeBlock(ptr, osize);
+	return newPtr;
+}
+
+lua_State *Lua::CreateState(PoolAllocator &allocator)
+{
+	auto *lua = lua::new_state(PoolAllocator::Allocate, &allocator);
+	if(lua == nullptr)
+		return nullptr;
+	luaL_openlibs(lua);
+	return lua;
+}
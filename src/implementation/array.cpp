@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :array;
+
+bool Lua::push_ffi_library(lua_State *l)
+{
+#ifndef USE_LUAJIT
+	return false;
+#else
+	luaL_checkstack(l, 3, nullptr);
+	lua_getfield(l, LUA_REGISTRYINDEX, "_LOADED");
+	if(!lua_istable(l, -1)) {
+		lua_pop(l, 1);
+		return false;
+	}
+	lua_getfield(l, -1, LUA_FFILIBNAME);
+	if(!lua_istable(l, -1)) {
+		lua_pop(l, 1);
+		lua_pushcfunction(l, luaopen_ffi);
+		lua_pushstring(l, LUA_FFILIBNAME);
+		if(lua_pcall(l, 1, 1, 0) != 0 || !lua_istable(l, -1)) {
+			lua_pop(l, 2);
+			return false;
+		}
+		lua_pushvalue(l, -1);
+		lua_setfield(l, -3, LUA_FFILIBNAME);
+	}
+	lua_remove(l, -2);
+	return true;
+#endif
+}
+
+bool Lua::push_ffi_array(lua_State *l, const char *cType, const void *data, size_t count, size_t elementSize)
+{
+#ifdef USE_LUAJIT
+	luaL_checkstack(l, 6, nullptr);
+	if(!push_ffi_library(l))
+		return false;
+	auto ffiIdx = lua_gettop(l);
+
+	// Guard against structs that don't match their FFI declaration
+	lua_getfield(l, ffiIdx, "sizeof");
+	lua_pushstring(l, cType);
+	if(lua_pcall(l, 1, 1, 0) != 0 || lua_type(l, -1) != LUA_TNUMBER || static_cast<size_t>(lua_tointeger(l, -1)) != elementSize) {
+		lua_settop(l, ffiIdx - 1);
+		return false;
+	}
+	lua_pop(l, 1);
+
+	lua_getfield(l, ffiIdx, "new");
+	lua_pushfstring(l, "%s[?]", cType);
+	lua_pushinteger(l, static_cast<lua_Integer>(count));
+	if(lua_pcall(l, 2, 1, 0) != 0) {
+		lua_settop(l, ffiIdx - 1);
+		return false;
+	}
+	if(count > 0) {
+		// Light userdata is converted to a void pointer by the FFI
+		lua_getfield(l, ffiIdx, "copy");
+		lua_pushvalue(l, -2);
+		lua_pushlightuserdata(l, const_cast<void *>(data));
+		lua_pushinteger(l, static_cast<lua_Integer>(count * elementSize));
+		if(lua_pcall(l, 3, 0, 0) != 0) {
+			lua_settop(l, ffiIdx - 1);
+			return false;
+		}
+	}
+	lua_remove(l, ffiIdx);
+	return true;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,477 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :buffer_bridge;
+
+static char g_bufferBridgeKey = 0;
+static char g_viewFactoryKey = 0;
+
+// Returns a function that creates a view of a buffer. The view reads the header of the buffer's slot through the FFI
+// on every access, so it detects released buffers and follows updated memory without any calls into C.
+static constexpr const char *VIEW_FACTORY_SCRIPT = R"(
+local ffi = ...
+ffi.cdef[[
+typedef struct { void *data; uint64_t count; uint32_t generation; uint32_t readOnly; } luasystem_buffer_header_t;
+]]
+local headerPtrType = ffi.typeof("luasystem_buffer_header_t*")
+local cast, typeof, error, tostring, setmetatable = ffi.cast, ffi.typeof, error, tostring, setmetatable
+local ptrTypes = {}
+return function(block, offset, generation, cType)
+	local header = cast(headerPtrType, block) + offset
+	local ptrType = ptrTypes[cType]
+	if ptrType == nil then
+		ptrType = typeof(cType .. "*")
+		ptrTypes[cType] = ptrType
+	end
+	local function check(i)
+		if header.generation ~= generation then
+			error("attempt to access a native buffer that has been released", 3)
+		end
+		if i < 0 or i >= header.count then
+			error("index " .. tostring(i) .. " out of range", 3)
+		end
+	end
+	return setmetatable({}, {
+		__index = function(_, i)
+			check(i)
+			return cast(ptrType, header.data)[i]
+		end,
+		__newindex = function(_, i, value)
+			check(i)
+			if header.readOnly ~= 0 then
+				error("attempt to write to a read-only native buffer", 2)
+			end
+			cast(ptrType, header.data)[i] = value
+		end,
+		-- Keeps the header memory alive for as long as the view exists
+		block = block,
+	})
+end
+)";
+
+Lua::BufferBridge::BufferBridge(lua_State *l) : m_state {l}
+{
+	lua_pushlightuserdata(l, &g_bufferBridgeKey);
+	lua_pushlightuserdata(l, this);
+	lua_rawset(l, LUA_REGISTRYINDEX);
+
+	luaL_checkstack(l, 3, nullptr);
+	if(luaL_newmetatable(l, TYPE_NAME)) {
+		const luaL_Reg methods[] = {
+		  {"IsValid", LuaIsValid},
+		  {"GetSize", LuaGetSize},
+		  {"GetByteSize", LuaGetByteSize},
+		  {"IsReadOnly", LuaIsReadOnly},
+		  {"Get", LuaGet},
+		  {"Set", LuaSet},
+		  {"ToTable", LuaToTable},
+#ifdef USE_LUAJIT
+		  {"GetView", LuaGetView},
+		  {"GetPointer", LuaGetPointer},
+#endif
+		};
+		lua_createtable(l, 0, static_cast<int>(std::size(methods)));
+		for(auto &method : methods) {
+			lua_pushcfunction(l, method.func);
+			lua_setfield(l, -2, method.name);
+		}
+		lua_setfield(l, -2, "__index");
+		lua_pushcfunction(l, LuaGetSize);
+		lua_setfield(l, -2, "__len");
+		lua_pushcfunction(l, LuaToString);
+		lua_setfield(l, -2, "__tostring");
+	}
+	lua_pop(l, 1);
+}
+
+Lua::BufferBridge::~BufferBridge()
+{
+	// Script references that are still alive will report the buffers as released. Views keep the
+	// header blocks alive on their own, so they only need to be invalidated.
+	for(auto &block : m_headerBlocks) {
+		std::fill_n(block.headers, HEADER_BLOCK_SIZE, Header {});
+		luaL_unref(m_state, LUA_REGISTRYINDEX, block.reference);
+	}
+	lua_pushlightuserdata(m_state, &g_bufferBridgeKey);
+	lua_pushnil(m_state);
+	lua_rawset(m_state, LUA_REGISTRYINDEX);
+}
+
+Lua::BufferBridge *Lua::BufferBridge::Get(lua_State *l)
+{
+	lua_pushlightuserdata(l, &g_bufferBridgeKey);
+	lua_rawget(l, LUA_REGISTRYINDEX);
+	auto *bridge = static_cast<BufferBridge *>(lua_touserdata(l, -1));
+	lua_pop(l, 1);
+	return bridge;
+}
+
+Lua::BufferBridge::Handle Lua::BufferBridge::Register(void *data, size_t count, ElementType type, size_t elementSize, std::string cType, bool readOnly)
+{
+	uint32_t index;
+	if(!m_freeSlots.empty()) {
+		index = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else {
+		index = static_cast<uint32_t>(m_slots.size());
+		m_slots.push_back({});
+	}
+	auto &slot = m_slots[index];
+	slot.data = data;
+	slot.count = count;
+	slot.elementSize = elementSize;
+	slot.cType = std::move(cType);
+	slot.type = type;
+	slot.active = true;
+	slot.readOnly = readOnly;
+	ReserveHeaders(index + 1);
+	SyncHeader(index);
+	return {index, slot.generation};
+}
+
+void Lua::BufferBridge::ReserveHeaders(uint32_t count)
+{
+	while(m_headerBlocks.size() * HEADER_BLOCK_SIZE < count) {
+		auto *headers = static_cast<Header *>(lua_newuserdata(m_state, sizeof(Header) * HEADER_BLOCK_SIZE));
+		std::uninitialized_fill_n(headers, HEADER_BLOCK_SIZE, Header {});
+		m_headerBlocks.push_back({luaL_ref(m_state, LUA_REGISTRYINDEX), headers});
+	}
+}
+
+void Lua::BufferBridge::SyncHeader(uint32_t index)
+{
+	auto &slot = m_slots[index];
+	auto &header = m_headerBlocks[index / HEADER_BLOCK_SIZE].headers[index % HEADER_BLOCK_SIZE];
+	header.data = slot.data;
+	header.count = slot.count;
+	// Generation 0 is never valid, so views of inactive slots always fail the check
+	header.generation = slot.active ? slot.generation : 0;
+	header.readOnly = slot.readOnly ? 1 : 0;
+}
+
+Lua::BufferBridge::Slot *Lua::BufferBridge::FindSlot(Handle handle) { return const_cast<Slot *>(const_cast<const BufferBridge *>(this)->FindSlot(handle)); }
+const Lua::BufferBridge::Slot *Lua::BufferBridge::FindSlot(Handle handle) const
+{
+	if(handle.index >= m_slots.size())
+		return nullptr;
+	auto &slot = m_slots[handle.index];
+	if(!slot.active || slot.generation != handle.generation)
+		return nullptr;
+	return &slot;
+}
+
+bool Lua::BufferBridge::Update(Handle handle, void *data, size_t count)
+{
+	auto *slot = FindSlot(handle);
+	if(!slot)
+		return false;
+	slot->data = data;
+	slot->count = count;
+	SyncHeader(handle.index);
+	return true;
+}
+
+void Lua::BufferBridge::Release(Handle handle)
+{
+	auto *slot = FindSlot(handle);
+	if(!slot)
+		return;
+	slot->active = false;
+	slot->data = nullptr;
+	slot->count = 0;
+	slot->cType.clear();
+	// Invalidates all outstanding references to the slot
+	++slot->generation;
+	if(slot->generation == 0)
+		slot->generation = 1;
+	SyncHeader(handle.index);
+	m_freeSlots.push_back(handle.index);
+}
+
+bool Lua::BufferBridge::IsValid(Handle handle) const { return FindSlot(handle) != nullptr; }
+
+void Lua::BufferBridge::Push(lua_State *l, Handle handle) const
+{
+	if(!IsValid(handle)) {
+		lua_pushnil(l);
+		return;
+	}
+	luaL_checkstack(l, 2, nullptr);
+	*static_cast<Handle *>(lua_newuserdata(l, sizeof(Handle))) = handle;
+	luaL_getmetatable(l, TYPE_NAME);
+	lua_setmetatable(l, -2);
+}
+
+bool Lua::BufferBridge::PushView(lua_State *l, Handle handle) const
+{
+	auto *slot = FindSlot(handle);
+	if(slot == nullptr || slot->cType.empty())
+		return false;
+	luaL_checkstack(l, 2, nullptr);
+	lua_pushcfunction(l, LuaGetView);
+	Push(l, handle);
+	if(lua_pcall(l, 1, 1, 0) != 0) {
+		lua_pop(l, 1);
+		return false;
+	}
+	return true;
+}
+
+Lua::BufferBridge::Handle Lua::BufferBridge::GetHandle(lua_State *l, int32_t idx)
+{
+	auto *p = lua_touserdata(l, idx);
+	if(p == nullptr || !lua_getmetatable(l, idx))
+		return {};
+	luaL_getmetatable(l, TYPE_NAME);
+	auto isBuffer = lua_rawequal(l, -1, -2);
+	lua_pop(l, 2);
+	return isBuffer ? *static_cast<Handle *>(p) : Handle {};
+}
+
+Lua::BufferBridge::Slot &Lua::BufferBridge::CheckSlot(lua_State *l, int32_t idx)
+{
+	auto handle = *static_cast<Handle *>(luaL_checkudata(l, idx, TYPE_NAME));
+	auto *bridge = Get(l);
+	auto *slot = bridge ? bridge->FindSlot(handle) : nullptr;
+	if(slot == nullptr)
+		luaL_error(l, "attempt to access a native buffer that has been released");
+	return *slot;
+}
+
+size_t Lua::BufferBridge::CheckIndex(lua_State *l, const Slot &slot, int32_t idx)
+{
+	if(slot.type == ElementType::Struct)
+		luaL_error(l, "elements of struct buffers can only be accessed through GetPointer");
+	// Zero-based, like the FFI pointer
+	auto index = luaL_checkinteger(l, idx);
+	if(index < 0 || static_cast<size_t>(index) >= slot.count)
+		luaL_argerror(l, idx, lua_pushfstring(l, "index %d out of range [0, %d)", static_cast<int>(index), static_cast<int>(slot.count)));
+	return static_cast<size_t>(index);
+}
+
+template<typename T>
+static T read_element(const void *data, size_t index)
+{
+	T value;
+	std::memcpy(&value, static_cast<const std::byte *>(data) + index * sizeof(T), sizeof(T));
+	return value;
+}
+
+template<typename T>
+static void write_element(void *data, size_t index, T value)
+{
+	std::memcpy(static_cast<std::byte *>(data) + index * sizeof(T), &value, sizeof(T));
+}
+
+// Converting NaN or a value that is out of range to an integer (or a finite value that is out of range to a float) is
+// undefined behavior, so these are rejected instead
+template<typename T>
+static T check_element_value(lua_State *l, int32_t idx)
+{
+	auto value = luaL_checknumber(l, idx);
+	if constexpr(std::is_integral_v<T>) {
+		// Both bounds are powers of two and therefore exact, the upper one is exclusive
+		constexpr auto min = static_cast<lua_Number>(std::numeric_limits<T>::min());
+		constexpr auto max = static_cast<lua_Number>(std::numeric_limits<T>::max() / 2 + 1) * 2.0;
+		if(!(value >= min && value < max) || value != std::trunc(value))
+			luaL_argerror(l, idx, lua_pushfstring(l, "%f is not a valid %s value", value, get_ffi_type_name<T>()));
+	}
+	else if constexpr(std::is_same_v<T, float>) {
+		if(std::isfinite(value) && std::abs(value) > static_cast<lua_Number>(std::numeric_limits<float>::max()))
+			luaL_argerror(l, idx, lua_pushfstring(l, "%f is out of range for float", value));
+	}
+	return static_cast<T>(value);
+}
+
+void Lua::BufferBridge::PushElement(lua_State *l, const Slot &slot, size_t index)
+{
+	switch(slot.type) {
+	case ElementType::Int8:
+		lua_pushinteger(l, read_element<int8_t>(slot.data, index));
+		break;
+	case ElementType::UInt8:
+		lua_pushinteger(l, read_element<uint8_t>(slot.data, index));
+		break;
+	case ElementType::Int16:
+		lua_pushinteger(l, read_element<int16_t>(slot.data, index));
+		break;
+	case ElementType::UInt16:
+		lua_pushinteger(l, read_element<uint16_t>(slot.data, index));
+		break;
+	case ElementType::Int32:
+		lua_pushinteger(l, read_element<int32_t>(slot.data, index));
+		break;
+	case ElementType::UInt32:
+		lua_pushnumber(l, read_element<uint32_t>(slot.data, index));
+		break;
+	case ElementType::Int64:
+		lua_pushnumber(l, static_cast<lua_Number>(read_element<int64_t>(slot.data, index)));
+		break;
+	case ElementType::UInt64:
+		lua_pushnumber(l, static_cast<lua_Number>(read_element<uint64_t>(slot.data, index)));
+		break;
+	case ElementType::Float:
+		lua_pushnumber(l, read_element<float>(slot.data, index));
+		break;
+	case ElementType::Double:
+		lua_pushnumber(l, read_element<double>(slot.data, index));
+		break;
+	default:
+		lua_pushnil(l);
+		break;
+	}
+}
+
+int32_t Lua::BufferBridge::LuaIsValid(lua_State *l)
+{
+	auto handle = *static_cast<Handle *>(luaL_checkudata(l, 1, TYPE_NAME));
+	auto *bridge = Get(l);
+	lua_pushboolean(l, bridge && bridge->IsValid(handle));
+	return 1;
+}
+
+int32_t Lua::BufferBridge::LuaGetSize(lua_State *l)
+{
+	lua_pushinteger(l, static_cast<lua_Integer>(CheckSlot(l, 1).count));
+	return 1;
+}
+
+int32_t Lua::BufferBridge::LuaGetByteSize(lua_State *l)
+{
+	auto &slot = CheckSlot(l, 1);
+	lua_pushnumber(l, static_cast<lua_Number>(slot.count * slot.elementSize));
+	return 1;
+}
+
+int32_t Lua::BufferBridge::LuaIsReadOnly(lua_State *l)
+{
+	lua_pushboolean(l, CheckSlot(l, 1).readOnly);
+	return 1;
+}
+
+int32_t Lua::BufferBridge::LuaGet(lua_State *l)
+{
+	auto &slot = CheckSlot(l, 1);
+	PushElement(l, slot, CheckIndex(l, slot, 2));
+	return 1;
+}
+
+int32_t Lua::BufferBridge::LuaSet(lua_State *l)
+{
+	auto &slot = CheckSlot(l, 1);
+	auto index = CheckIndex(l, slot, 2);
+	if(slot.readOnly)
+		luaL_error(l, "attempt to write to a read-only native buffer");
+	switch(slot.type) {
+	case ElementType::Int8:
+		write_element(slot.data, index, check_element_value<int8_t>(l, 3));
+		break;
+	case ElementType::UInt8:
+		write_element(slot.data, index, check_element_value<uint8_t>(l, 3));
+		break;
+	case ElementType::Int16:
+		write_element(slot.data, index, check_element_value<int16_t>(l, 3));
+		break;
+	case ElementType::UInt16:
+		write_element(slot.data, index, check_element_value<uint16_t>(l, 3));
+		break;
+	case ElementType::Int32:
+		write_element(slot.data, index, check_element_value<int32_t>(l, 3));
+		break;
+	case ElementType::UInt32:
+		write_element(slot.data, index, check_element_value<uint32_t>(l, 3));
+		break;
+	case ElementType::Int64:
+		write_element(slot.data, index, check_element_value<int64_t>(l, 3));
+		break;
+	case ElementType::UInt64:
+		write_element(slot.data, index, check_element_value<uint64_t>(l, 3));
+		break;
+	case ElementType::Float:
+		write_element(slot.data, index, check_element_value<float>(l, 3));
+		break;
+	case ElementType::Double:
+		write_element(slot.data, index, check_element_value<double>(l, 3));
+		break;
+	default:
+		break;
+	}
+	return 0;
+}
+
+int32_t Lua::BufferBridge::LuaToTable(lua_State *l)
+{
+	auto &slot = CheckSlot(l, 1);
+	if(slot.type == ElementType::Struct)
+		luaL_error(l, "elements of struct buffers can only be accessed through GetPointer");
+	luaL_checkstack(l, 2, nullptr);
+	lua_createtable(l, static_cast<int>(slot.count), 0);
+	for(size_t i = 0; i < slot.count; ++i) {
+		PushElement(l, slot, i);
+		lua_rawseti(l, -2, static_cast<int>(i + 1));
+	}
+	return 1;
+}
+
+int32_t Lua::BufferBridge::LuaGetView(lua_State *l)
+{
+	auto handle = *static_cast<Handle *>(luaL_checkudata(l, 1, TYPE_NAME));
+	auto &slot = CheckSlot(l, 1);
+	if(slot.cType.empty())
+		luaL_error(l, "views require the buffer to have been registered with a C type");
+	luaL_checkstack(l, 6, nullptr);
+	lua_pushlightuserdata(l, &g_viewFactoryKey);
+	lua_rawget(l, LUA_REGISTRYINDEX);
+	if(lua_isnil(l, -1)) {
+		lua_pop(l, 1);
+		if(luaL_loadbuffer(l, VIEW_FACTORY_SCRIPT, std::strlen(VIEW_FACTORY_SCRIPT), "=NativeBuffer") != 0)
+			lua_error(l);
+		if(!push_ffi_library(l))
+			luaL_error(l, "the FFI library is not available");
+		lua_call(l, 1, 1);
+		lua_pushlightuserdata(l, &g_viewFactoryKey);
+		lua_pushvalue(l, -2);
+		lua_rawset(l, LUA_REGISTRYINDEX);
+	}
+	auto &block = Get(l)->m_headerBlocks[handle.index / HEADER_BLOCK_SIZE];
+	lua_rawgeti(l, LUA_REGISTRYINDEX, block.reference);
+	lua_pushinteger(l, static_cast<lua_Integer>(handle.index % HEADER_BLOCK_SIZE));
+	lua_pushnumber(l, static_cast<lua_Number>(handle.generation));
+	lua_pushstring(l, slot.cType.c_str());
+	lua_call(l, 4, 1);
+	return 1;
+}
+
+int32_t Lua::BufferBridge::LuaGetPointer(lua_State *l)
+{
+	auto &slot = CheckSlot(l, 1);
+	luaL_checkstack(l, 4, nullptr);
+	if(!push_ffi_library(l))
+		luaL_error(l, "the FFI library is not available");
+	lua_getfield(l, -1, "cast");
+	lua_remove(l, -2);
+	auto *cType = slot.cType.empty() ? "void" : slot.cType.c_str();
+	lua_pushfstring(l, slot.readOnly ? "const %s*" : "%s*", cType);
+	lua_pushlightuserdata(l, slot.data);
+	lua_call(l, 2, 1);
+	return 1;
+}
+
+int32_t Lua::BufferBridge::LuaToString(lua_State *l)
+{
+	auto handle = *static_cast<Handle *>(luaL_checkudata(l, 1, TYPE_NAME));
+	auto *bridge = Get(l);
+	auto *slot = bridge ? bridge->FindSlot(handle) : nullptr;
+	if(slot == nullptr)
+		lua_pushstring(l, "NativeBuffer[released]");
+	else
+		lua_pushfstring(l, "NativeBuffer[%d x %s]", static_cast<int>(slot->count), slot->cType.empty() ? "void" : slot->cType.c_str());
+	return 1;
+}
@@ -0,0 +1,170 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :bytecode_cache;
+
+Lua::BytecodeCache &Lua::BytecodeCache::Get()
+{
+	static BytecodeCache cache;
+	return cache;
+}
+
+std::string Lua::BytecodeCache::GetKey(const std::string_view &path, bool precompiledFiles)
+{
+	std::string key;
+	key.reserve(path.size() + 1);
+	key += precompiledFiles ? 'c' : 't';
+	key += path;
+	return key;
+}
+
+std::optional<Lua::BytecodeCache::FileStamp> Lua::BytecodeCache::GetFileStamp(const std::string &diskPath)
+{
+	std::error_code ec;
+	std::filesystem::directory_entry entry {diskPath, ec};
+	if(ec)
+		return {};
+	FileStamp stamp {};
+	auto t = entry.last_write_time(ec);
+	if(ec)
+		return {};
+	stamp.lastWriteTime = t.time_since_epoch().count();
+	stamp.fileSize = entry.file_size(ec);
+	if(ec)
+		return {};
+	return stamp;
+}
+
+std::shared_ptr<const Lua::BytecodeCache::Chunk> Lua::BytecodeCache::Find(const std::string &key)
+{
+	std::shared_ptr<const Chunk> chunk;
+	{
+		std::scoped_lock lock {m_mutex};
+		auto it = m_entries.find(key);
+		if(it == m_entries.end()) {
+			++m_misses;
+			return nullptr;
+		}
+		chunk = it->second->chunk;
+	}
+	// The file is validated outside of the lock, so concurrent look-ups of other entries aren't blocked by the file system
+	auto stamp = GetFileStamp(chunk->diskPath);
+	std::scoped_lock lock {m_mutex};
+	auto it = m_entries.find(key);
+	if(!stamp || !(*stamp == chunk->stamp)) {
+		// File has changed since it was cached
+		if(it != m_entries.end() && it->second->chunk == chunk)
+			Erase(it->second);
+		++m_misses;
+		return nullptr;
+	}
+	if(it != m_entries.end() && it->second->chunk == chunk)
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+	++m_hits;
+	return chunk;
+}
+
+void Lua::BytecodeCache::Insert(const std::string &key, Chunk chunk)
+{
+	auto size = chunk.bytecode.size();
+	std::scoped_lock lock {m_mutex};
+	if(size > m_maxSize)
+		return;
+	auto it = m_entries.find(key);
+	if(it != m_entries.end())
+		Erase(it->second);
+	m_lru.push_front({key, std::make_shared<const Chunk>(std::move(chunk))});
+	m_entries[key] = m_lru.begin();
+	m_size += size;
+	Evict();
+}
+
+void Lua::BytecodeCache::Remove(const std::string_view &path)
+{
+	std::scoped_lock lock {m_mutex};
+	for(auto precompiledFiles : {true, false}) {
+		auto it = m_entries.find(GetKey(path, precompiledFiles));
+		if(it != m_entries.end())
+			Erase(it->second);
+	}
+}
+
+void Lua::BytecodeCache::Clear()
+{
+	std::scoped_lock lock {m_mutex};
+	m_entries.clear();
+	m_lru.clear();
+	m_size = 0;
+}
+
+void Lua::BytecodeCache::Erase(std::list<Entry>::iterator it)
+{
+	m_size -= it->chunk->bytecode.size();
+	m_entries.erase(it->key);
+	m_lru.erase(it);
+}
+
+void Lua::BytecodeCache::Evict()
+{
+	while(m_size > m_maxSize && !m_lru.empty()) {
+		Erase(std::prev(m_lru.end()));
+		++m_evictions;
+	}
+}
+
+void Lua::BytecodeCache::SetEnabled(bool enabled)
+{
+	m_enabled = enabled;
+	if(!enabled)
+		Clear();
+}
+bool Lua::BytecodeCache::IsEnabled() const { return m_enabled; }
+
+void Lua::BytecodeCache::SetMaxSize(size_t maxSizeInBytes)
+{
+	std::scoped_lock lock {m_mutex};
+	m_maxSize = maxSizeInBytes;
+	Evict();
+}
+
+Lua::BytecodeCache::Stats Lua::BytecodeCache::GetStats() const
+{
+	std::scoped_lock lock {m_mutex};
+	Stats stats {};
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.evictions = m_evictions;
+	stats.entryCount = m_entries.size();
+	stats.sizeInBytes = m_size;
+	stats.maxSizeInBytes = m_maxSize;
+	return stats;
+}
+
+void Lua::BytecodeCache::ResetStats()
+{
+	m_hits = 0;
+	m_misses = 0;
+	m_evictions = 0;
+}
+
+static int write_bytecode(lua_State *, const void *p, size_t sz, void *ud)
+{
+	static_cast<std::string *>(ud)->append(static_cast<const char *>(p), sz);
+	return 0;
+}
+
+bool Lua::dump_bytecode(lua_State *l, std::string &outBytecode, bool strip)
+{
+	outBytecode.clear();
+#ifdef USE_LUAJIT
+	return lua_dump_strip(l, write_bytecode, &outBytecode, strip ? 1 : 0) == 0;
+#else
+	return lua_dump(l, write_bytecode, &outBytecode) == 0;
+#endif
+}
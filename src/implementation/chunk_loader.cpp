@@ -0,0 +1,148 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+module pragma.lua;
+
+import :chunk_loader;
+
+std::unique_ptr<Lua::MappedFile> Lua::MappedFile::Open(const std::string &path)
+{
+	std::unique_ptr<MappedFile> mappedFile {new MappedFile {}};
+#ifdef _WIN32
+	auto hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(hFile == INVALID_HANDLE_VALUE)
+		return nullptr;
+	mappedFile->m_fileHandle = hFile;
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(hFile, &size) || size.QuadPart == 0)
+		return nullptr;
+	auto hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(hMapping == nullptr)
+		return nullptr;
+	mappedFile->m_mappingHandle = hMapping;
+	auto *data = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if(data == nullptr)
+		return nullptr;
+	mappedFile->m_data = static_cast<const char *>(data);
+	mappedFile->m_size = static_cast<size_t>(size.QuadPart);
+#else
+	auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd == -1)
+		return nullptr;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return nullptr;
+	}
+	auto *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping stays valid after the descriptor has been closed
+	close(fd);
+	if(data == MAP_FAILED)
+		return nullptr;
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+	mappedFile->m_data = static_cast<const char *>(data);
+	mappedFile->m_size = static_cast<size_t>(st.st_size);
+#endif
+	return mappedFile;
+}
+
+Lua::MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if(m_data)
+		UnmapViewOfFile(m_data);
+	if(m_mappingHandle)
+		CloseHandle(m_mappingHandle);
+	if(m_fileHandle)
+		CloseHandle(m_fileHandle);
+#else
+	if(m_data)
+		munmap(const_cast<char *>(m_data), m_size);
+#endif
+}
+
+const char *Lua::MappedFile::GetData() const { return m_data; }
+size_t Lua::MappedFile::GetSize() const { return m_size; }
+
+const char *Lua::get_load_mode_string(LoadMode mode)
+{
+	switch(mode) {
+	case LoadMode::TextOnly:
+		return "t";
+	case LoadMode::BinaryOnly:
+		return "b";
+	default:
+		return "bt";
+	}
+}
+
+namespace {
+	struct VFileReader {
+		VFilePtrInternal *file = nullptr;
+		std::chrono::nanoseconds *readTime = nullptr;
+		std::array<char, Lua::CHUNK_READ_BUFFER_SIZE> buffer;
+	};
+	struct MemoryReader {
+		const char *data = nullptr;
+		size_t size = 0;
+	};
+}
+
+static const char *read_vfile_chunk(lua_State *, void *ud, size_t *size)
+{
+	auto &reader = *static_cast<VFileReader *>(ud);
+	if(reader.readTime) {
+		auto t = std::chrono::steady_clock::now();
+		*size = reader.file->Read(reader.buffer.data(), reader.buffer.size());
+		*reader.readTime += std::chrono::steady_clock::now() - t;
+	}
+	else
+		*size = reader.file->Read(reader.buffer.data(), reader.buffer.size());
+	return (*size > 0) ? reader.buffer.data() : nullptr;
+}
+
+static const char *read_memory_chunk(lua_State *, void *ud, size_t *size)
+{
+	auto &reader = *static_cast<MemoryReader *>(ud);
+	*size = reader.size;
+	reader.size = 0; // The entire block is handed over at once
+	return (*size > 0) ? reader.data : nullptr;
+}
+
+Lua::StatusCode Lua::load_chunk(lua_State *l, const char *data, size_t size, const std::string &chunkName, LoadMode mode)
+{
+	MemoryReader reader {data, size};
+	return static_cast<StatusCode>(lua::load_with_mode(l, read_memory_chunk, &reader, chunkName.c_str(), get_load_mode_string(mode)));
+}
+
+Lua::StatusCode Lua::load_chunk(lua_State *l, VFilePtr &f, const std::string &chunkName, LoadMode mode, std::chrono::nanoseconds *outReadTime)
+{
+	if(outReadTime)
+		*outReadTime = std::chrono::nanoseconds {0};
+	auto fReal = std::dynamic_pointer_cast<VFilePtrInternalReal>(f);
+	if(fReal != nullptr && f->GetSize() >= MIN_MAPPED_CHUNK_SIZE) {
+		auto t = outReadTime ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point {};
+		auto mappedFile = MappedFile::Open(fReal->GetPath());
+		if(outReadTime)
+			*outReadTime = std::chrono::steady_clock::now() - t;
+		if(mappedFile)
+			return load_chunk(l, mappedFile->GetData(), mappedFile->GetSize(), chunkName, mode);
+		// Fall back to streaming
+	}
+	VFileReader reader {};
+	reader.file = f.get();
+	reader.readTime = outReadTime;
+	return static_cast<StatusCode>(lua::load_with_mode(l, read_vfile_chunk, &reader, chunkName.c_str(), get_load_mode_string(mode)));
+}
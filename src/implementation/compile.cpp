@@ -8,30 +8,226 @@ module;
 module pragma.lua;
 
 import :core;
+import :bytecode_cache;
+import :chunk_loader;
+import :compiler;
+import :script_bundle;
+import :script_manifest;
 
-VFilePtrReal fLuaCompile = nullptr;
-static int luaWriteBinary(lua_State *, unsigned char *str, size_t len, luaL_Buffer *)
+static int luaWriteBinary(lua_State *, const void *str, size_t len, void *ud)
 {
-	fLuaCompile->Write(str, len);
-	return 0;
+	// A non-zero result aborts the dump
+	return (static_cast<VFilePtrInternalReal *>(ud)->Write(str, len) == len) ? 0 : 1;
 }
 
 bool Lua::compile_file(lua_State *l, const std::string &path)
 {
 	auto lpath = ufile::get_path_from_filename(path);
 	FileManager::CreatePath(lpath.c_str());
-	fLuaCompile = FileManager::OpenFile<VFilePtrReal>(path.c_str(), "wb");
-	if(fLuaCompile == nullptr) {
+	auto f = FileManager::OpenFile<VFilePtrReal>(path.c_str(), "wb");
+	if(f == nullptr) {
 		Lua::Pop(l, 1);
 		return false;
 	}
-	luaL_Buffer buf;
-	luaL_buffinit(l, &buf);
+	// The output file is passed through the writer's user data, so multiple
+	// states can compile files concurrently.
 #ifdef USE_LUAJIT
-	lua_dump_strip(l, (lua_Writer)luaWriteBinary, &buf, 1);
+	auto r = lua_dump_strip(l, luaWriteBinary, f.get(), 1);
 #else
-	lua_dump(l, (lua_Writer)luaWriteBinary, &buf);
+	auto r = lua_dump(l, luaWriteBinary, f.get());
 #endif
-	fLuaCompile = nullptr;
+	if(r != 0) {
+		// Don't leave a truncated file behind, it would be preferred over the source file
+		std::filesystem::path filePath = f->GetPath();
+		f = nullptr;
+		std::error_code ec;
+		std::filesystem::remove(filePath, ec);
+		Lua::Pop(l, 1);
+		return false;
+	}
+	f = nullptr;
+	auto &manifest = ScriptManifest::Get();
+	if(manifest.IsEnabled()) {
+		// Precompiled files outside of the script directory are never looked up through the manifest
+		auto normPath = FileManager::GetNormalizedPath(path);
+		auto scriptDir = FileManager::GetNormalizedPath(SCRIPT_DIRECTORY_SLASH);
+		if(normPath.starts_with(scriptDir))
+			manifest.Update(std::string_view {normPath}.substr(scriptDir.length()));
+	}
 	return true;
 }
+
+static void find_script_files(const std::string &path, std::vector<std::string> &outFiles)
+{
+	std::vector<std::string> files;
+	std::vector<std::string> dirs;
+	FileManager::FindFiles((Lua::SCRIPT_DIRECTORY_SLASH + path + "*" + Lua::DOT_FILE_EXTENSION).c_str(), &files, nullptr);
+	FileManager::FindFiles((Lua::SCRIPT_DIRECTORY_SLASH + path + "*").c_str(), nullptr, &dirs);
+	outFiles.reserve(outFiles.size() + files.size());
+	for(auto &f : files)
+		outFiles.push_back(path + f);
+	for(auto &d : dirs)
+		find_script_files(path + d + '/', outFiles);
+}
+
+static std::optional<std::filesystem::file_time_type> get_last_write_time(const std::string &path)
+{
+	auto f = FileManager::OpenFile(path.c_str(), "rb");
+	auto fReal = std::dynamic_pointer_cast<VFilePtrInternalReal>(f);
+	if(fReal == nullptr)
+		return {};
+	std::error_code ec;
+	auto t = std::filesystem::last_write_time(fReal->GetPath(), ec);
+	if(ec)
+		return {};
+	return t;
+}
+
+static bool is_up_to_date(const std::string &sourcePath, const std::string &outputPath)
+{
+	auto tOutput = get_last_write_time(outputPath);
+	if(!tOutput)
+		return false;
+	auto tSource = get_last_write_time(sourcePath);
+	// Sources without a modification time (e.g. inside of archives) are considered unchanged
+	return !tSource || *tSource <= *tOutput;
+}
+
+// Loads the source file of 'result' and pushes the compiled function onto the stack, or sets the error of 'result' on failure
+static bool load_script(lua_State *l, Lua::CompileResult &result, const std::string &sourcePath)
+{
+	std::string err;
+	auto f = FileManager::OpenFile(sourcePath.c_str(), "rb", &err);
+	if(f == nullptr) {
+		result.error = "cannot open " + sourcePath + ": " + (!err.empty() ? err : "File not found");
+		return false;
+	}
+	auto r = Lua::load_chunk(l, f, "@" + sourcePath, Lua::LoadMode::TextOnly);
+	f = nullptr;
+	if(r != Lua::StatusCode::Ok) {
+		result.error = Lua::ToString(l, -1);
+		Lua::SetStackTop(l, 0);
+		return false;
+	}
+	return true;
+}
+
+static void compile_script(lua_State *l, Lua::CompileResult &result, bool force)
+{
+	auto sourcePath = Lua::SCRIPT_DIRECTORY_SLASH + result.sourcePath;
+	auto outputPath = Lua::SCRIPT_DIRECTORY_SLASH + result.outputPath;
+	if(!force && is_up_to_date(sourcePath, outputPath)) {
+		result.status = Lua::CompileResult::Status::UpToDate;
+		return;
+	}
+	if(!load_script(l, result, sourcePath))
+		return;
+	if(!Lua::compile_file(l, outputPath)) {
+		result.error = "cannot write " + outputPath;
+		Lua::SetStackTop(l, 0);
+		return;
+	}
+	Lua::SetStackTop(l, 0);
+	result.status = Lua::CompileResult::Status::Compiled;
+}
+
+static std::vector<Lua::CompileResult> get_compile_jobs(const Lua::BatchCompileInfo &info)
+{
+	auto subPath = FileManager::GetNormalizedPath(info.subPath);
+	if(!subPath.empty() && subPath.back() != '/')
+		subPath += '/';
+	std::vector<std::string> files;
+	find_script_files(subPath, files);
+
+	std::vector<Lua::CompileResult> results;
+	results.resize(files.size());
+	for(size_t i = 0; i < files.size(); ++i) {
+		auto &result = results[i];
+		result.sourcePath = std::move(files[i]);
+		result.outputPath = result.sourcePath.substr(0, result.sourcePath.length() - Lua::DOT_FILE_EXTENSION.length()) + Lua::DOT_FILE_EXTENSION_PRECOMPILED;
+	}
+	return results;
+}
+
+// Calls 'compile(l, jobIndex)' for every job on a pool of worker threads, with one lua state per worker
+template<typename TCompile>
+static void run_compile_jobs(std::vector<Lua::CompileResult> &results, const Lua::BatchCompileInfo &info, const TCompile &compile)
+{
+	if(results.empty())
+		return;
+	auto numThreads = info.threadCount;
+	if(numThreads == 0)
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	numThreads = std::min<uint32_t>(numThreads, results.size());
+
+	std::atomic<size_t> nextIndex = 0;
+	std::mutex callbackMutex;
+	auto worker = [&]() {
+		auto *l = luaL_newstate();
+		if(l == nullptr)
+			return;
+		for(;;) {
+			auto idx = nextIndex++;
+			if(idx >= results.size())
+				break;
+			auto &result = results[idx];
+			auto t = std::chrono::steady_clock::now();
+			compile(l, idx);
+			result.duration = std::chrono::steady_clock::now() - t;
+			if(info.onFileProcessed) {
+				std::scoped_lock lock {callbackMutex};
+				info.onFileProcessed(result);
+			}
+		}
+		lua_close(l);
+	};
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads - 1);
+	for(uint32_t i = 1; i < numThreads; ++i)
+		threads.emplace_back(worker);
+	worker();
+	for(auto &t : threads)
+		t.join();
+}
+
+std::vector<Lua::CompileResult> Lua::compile_files(const BatchCompileInfo &info)
+{
+	auto results = get_compile_jobs(info);
+	run_compile_jobs(results, info, [&results, &info](lua_State *l, size_t idx) { compile_script(l, results[idx], info.force); });
+	return results;
+}
+
+static void compile_script(lua_State *l, Lua::CompileResult &result, std::string &outBytecode)
+{
+	auto sourcePath = Lua::SCRIPT_DIRECTORY_SLASH + result.sourcePath;
+	if(!load_script(l, result, sourcePath))
+		return;
+	// Stripped like the precompiled files written by compile_file
+	auto success = Lua::dump_bytecode(l, outBytecode, true);
+	Lua::SetStackTop(l, 0);
+	if(!success) {
+		result.error = "cannot dump " + sourcePath;
+		return;
+	}
+	result.status = Lua::CompileResult::Status::Compiled;
+}
+
+bool Lua::create_script_bundle(const BatchCompileInfo &info, const std::string &outPath, std::vector<CompileResult> *outResults)
+{
+	auto results = get_compile_jobs(info);
+	// The scripts are written into the bundle instead
+	for(auto &result : results)
+		result.outputPath.clear();
+	std::vector<ScriptBundle::Script> scripts;
+	scripts.resize(results.size());
+	run_compile_jobs(results, info, [&results, &scripts](lua_State *l, size_t idx) {
+		scripts[idx].path = results[idx].sourcePath;
+		compile_script(l, results[idx], scripts[idx].bytecode);
+	});
+	auto success = std::all_of(results.begin(), results.end(), [](const CompileResult &result) { return result.status == CompileResult::Status::Compiled; });
+	if(success)
+		success = ScriptBundle::Write(outPath, scripts);
+	if(outResults)
+		*outResults = std::move(results);
+	return success;
+}
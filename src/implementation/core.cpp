@@ -8,6 +8,12 @@ module;
 module pragma.lua;
 
 import :core;
+import :bytecode_cache;
+import :chunk_loader;
+import :script_manifest;
+import :global_path;
+import :metrics;
+import :script_bundle;
 
 static void get_file_chunk_name(std::string &fileName)
 {
@@ -21,6 +27,38 @@ static std::string get_file_chunk_name(const std::string &fileName)
 	return chunkName;
 }
 
+namespace {
+	// Measures the duration of operations for the metrics of a lua state.
+	// Compiles to nothing if the library was built without metrics.
+	class MetricsTimer {
+	  public:
+		MetricsTimer(lua_State *l) : m_metrics {Lua::METRICS_ENABLED ? Lua::Metrics::Get(l) : nullptr} { Restart(); }
+		bool IsActive() const { return Lua::METRICS_ENABLED && m_metrics != nullptr; }
+		void Restart()
+		{
+			if(IsActive())
+				m_start = std::chrono::steady_clock::now();
+		}
+		// Records the time since the last call (or restart), excluding 'excludedTime'
+		void Record(Lua::Metrics::Operation op, const std::string_view &chunkName, bool success, std::chrono::nanoseconds excludedTime = {})
+		{
+			if(!IsActive())
+				return;
+			auto t = std::chrono::steady_clock::now();
+			m_metrics->Record(op, chunkName, std::chrono::duration_cast<std::chrono::nanoseconds>(t - m_start) - excludedTime, success);
+			m_start = t;
+		}
+		void RecordDuration(Lua::Metrics::Operation op, const std::string_view &chunkName, std::chrono::nanoseconds duration, bool success)
+		{
+			if(IsActive())
+				m_metrics->Record(op, chunkName, duration, success);
+		}
+	  private:
+		Lua::Metrics *m_metrics = nullptr;
+		std::chrono::steady_clock::time_point m_start {};
+	};
+}
+
 std::string Lua::SCRIPT_DIRECTORY = "lua";
 std::string Lua::SCRIPT_DIRECTORY_SLASH = "lua/";
 std::string Lua::FILE_EXTENSION = "lua";
@@ -41,53 +79,132 @@ lua_State *Lua::CreateState()
 
 void Lua::CloseState(lua_State *lua) { lua_close(lua); }
 
-static bool s_precompiledFilesEnabled = true;
+static char g_loaderContextKey = 0;
+static std::atomic<bool> s_precompiledFilesEnabled = true;
+// Context of the state that is executing a file on this thread, for look-ups that have no access to the state
+static thread_local Lua::LoaderContext *t_currentLoaderContext = nullptr;
+
+static int32_t destroy_loader_context(lua_State *l)
+{
+	auto *context = static_cast<Lua::LoaderContext *>(lua_touserdata(l, 1));
+	context->~LoaderContext();
+	return 0;
+}
+
+Lua::LoaderContext &Lua::get_loader_context(lua_State *l)
+{
+	lua_pushlightuserdata(l, &g_loaderContextKey);
+	lua_rawget(l, LUA_REGISTRYINDEX);
+	auto *context = static_cast<LoaderContext *>(lua_touserdata(l, -1));
+	lua_pop(l, 1);
+	if(context)
+		return *context;
+	luaL_checkstack(l, 3, nullptr);
+	context = new(lua_newuserdata(l, sizeof(LoaderContext))) LoaderContext {};
+	lua_createtable(l, 0, 1);
+	lua_pushcfunction(l, destroy_loader_context);
+	lua_setfield(l, -2, "__gc");
+	lua_setmetatable(l, -2);
+	lua_pushlightuserdata(l, &g_loaderContextKey);
+	lua_insert(l, -2);
+	lua_rawset(l, LUA_REGISTRYINDEX);
+	return *context;
+}
+
 void Lua::set_precompiled_files_enabled(bool bEnabled) { s_precompiledFilesEnabled = bEnabled; }
 bool Lua::are_precompiled_files_enabled() { return s_precompiledFilesEnabled; }
+void Lua::set_precompiled_files_enabled(lua_State *l, bool bEnabled) { get_loader_context(l).precompiledFilesEnabled = bEnabled; }
+bool Lua::are_precompiled_files_enabled(lua_State *l) { return get_loader_context(l).precompiledFilesEnabled.value_or(s_precompiledFilesEnabled); }
+
+static int get_global_nested_value(lua_State *l)
+{
+	size_t len;
+	auto *str = lua_tolstring(l, 1, &len);
+	std::string_view path {str, len};
+	lua_pushvalue(l, LUA_GLOBALSINDEX);
+	for(;;) {
+		auto sep = path.find('.');
+		auto name = path.substr(0, sep);
+		lua_pushlstring(l, name.data(), name.size());
+		lua_gettable(l, -2);
+		lua_remove(l, -2);
+		if(sep == std::string_view::npos || lua_isnil(l, -1))
+			break;
+		path = path.substr(sep + 1);
+	}
+	return 1;
+}
 
-void Lua::get_global_nested_library(lua_State *l, const std::string &name)
+void Lua::get_global_nested_library(lua_State *l, const std::string_view &name)
 {
-	std::vector<std::string> libs;
-	ustring::explode(name, ".", libs);
-	if(libs.empty() == false) {
-		Lua::GetGlobal(l, libs.front()); /* 1 */
-		if(Lua::IsSet(l, -1) == false) {
-			Lua::Pop(l, 1); /* 0 */
-			Lua::PushNil(l);
-			return;
-		}
-		if(libs.size() == 1)
-			return;
-		for(auto it = libs.begin() + 1; it != libs.end(); ++it) {
-			auto bLast = (it == libs.end() - 1);
-			auto &lib = *it;
-			auto t = Lua::GetStackTop(l);
-			auto status = Lua::GetProtectedTableValue(l, t, lib);
-			if(status != Lua::StatusCode::Ok) {
-				Lua::PushNil(l);
-				return;
+	if(name.empty()) {
+		Lua::PushNil(l);
+		return;
+	}
+	// The entire path is resolved within a single protected call
+	push_cached_c_function(l, get_global_nested_value);
+	lua_pushlstring(l, name.data(), name.size());
+	if(lua_pcall(l, 1, 1, 0) != 0) {
+		Lua::Pop(l, 1);
+		Lua::PushNil(l);
+	}
+}
+
+Lua::StatusCode Lua::LoadFile(lua_State *lua, std::string &fInOut, fsys::SearchFlags includeFlags, fsys::SearchFlags excludeFlags, LoadMode mode)
+{
+	MetricsTimer timer {lua};
+	auto unrestricted = includeFlags == fsys::SearchFlags::All && excludeFlags == fsys::SearchFlags::None;
+	auto precompiledFiles = mode != LoadMode::TextOnly && are_precompiled_files_enabled(lua);
+	std::optional<ScriptManifest::Script> script {};
+	if(precompiledFiles) {
+		// The manifest doesn't know about search flags, so it can only be used for unrestricted look-ups
+		auto &manifest = ScriptManifest::Get();
+		auto useManifest = manifest.IsEnabled() && unrestricted;
+		if(useManifest)
+			script = manifest.FindScript(fInOut);
+		auto bundled = ScriptBundle::FindMounted(fInOut);
+		if(bundled) {
+			// Loose files take precedence over bundled scripts, so they can still be overridden (e.g. by mods)
+			auto hasLooseFile = useManifest ? script.has_value() : bundled->overridden;
+			if(!hasLooseFile) {
+				fInOut = FileManager::GetNormalizedPath(SCRIPT_DIRECTORY_SLASH + fInOut);
+				auto chunkName = get_file_chunk_name(fInOut);
+				timer.Record(Metrics::Operation::FileLookup, chunkName, true);
+				auto r = load_chunk(lua, bundled->bytecode.data(), bundled->bytecode.size(), chunkName, LoadMode::BinaryOnly);
+				timer.Record(Metrics::Operation::Parse, chunkName, r == StatusCode::Ok);
+				return r;
 			}
-			Lua::RemoveValue(l, -2);
-			if(bLast)
-				return;
 		}
 	}
-	Lua::PushNil(l);
-}
 
-Lua::StatusCode Lua::LoadFile(lua_State *lua, std::string &fInOut, fsys::SearchFlags includeFlags, fsys::SearchFlags excludeFlags)
-{
-	if(s_precompiledFilesEnabled) {
-		if(fInOut.length() > 3 && fInOut.substr(fInOut.length() - 4) == DOT_FILE_EXTENSION) {
-			auto cpath = fInOut.substr(0, fInOut.length() - 4) + DOT_FILE_EXTENSION_PRECOMPILED;
-			if(FileManager::Exists(SCRIPT_DIRECTORY_SLASH + cpath, includeFlags, excludeFlags) == true)
-				fInOut = cpath;
+	auto &bytecodeCache = BytecodeCache::Get();
+	// Cached entries are always binary, so restricted loads have to go through the file itself.
+	// The search flags aren't part of the key either.
+	auto useCache = bytecodeCache.IsEnabled() && mode == LoadMode::Any && unrestricted;
+	std::string cacheKey;
+	if(useCache) {
+		// Checked before the file is resolved, so a hit doesn't need any file system look-ups
+		cacheKey = BytecodeCache::GetKey(FileManager::GetNormalizedPath(SCRIPT_DIRECTORY_SLASH + fInOut), precompiledFiles);
+		auto chunk = bytecodeCache.Find(cacheKey);
+		if(chunk) {
+			fInOut = chunk->resolvedPath;
+			timer.Record(Metrics::Operation::FileLookup, chunk->chunkName, true);
+			auto r = load_chunk(lua, chunk->bytecode.data(), chunk->bytecode.size(), chunk->chunkName, LoadMode::BinaryOnly);
+			timer.Record(Metrics::Operation::Parse, chunk->chunkName, r == StatusCode::Ok);
+			return r;
 		}
 	}
+
+	if(precompiledFiles && fInOut.length() > 3 && fInOut.substr(fInOut.length() - 4) == DOT_FILE_EXTENSION) {
+		auto cpath = fInOut.substr(0, fInOut.length() - 4) + DOT_FILE_EXTENSION_PRECOMPILED;
+		if(script ? script->hasPrecompiled : FileManager::Exists(SCRIPT_DIRECTORY_SLASH + cpath, includeFlags, excludeFlags))
+			fInOut = cpath;
+	}
 	fInOut = FileManager::GetNormalizedPath(SCRIPT_DIRECTORY_SLASH + fInOut);
 	std::string err;
 	auto f = FileManager::OpenFile(fInOut.c_str(), "rb", &err, includeFlags, excludeFlags);
 	if(f == nullptr) {
+		timer.Record(Metrics::Operation::FileLookup, get_file_chunk_name(fInOut), false);
 		lua_pushfstring(lua, ("cannot open %s: " + (!err.empty() ? err : "File not found")).c_str(), fInOut.c_str());
 		return StatusCode::ErrorFile;
 	}
@@ -99,17 +216,34 @@ Lua::StatusCode Lua::LoadFile(lua_State *lua, std::string &fInOut, fsys::SearchF
 		static auto len = FileManager::GetProgramPath().length();
 		nf = nf.substr(len + 1);
 	}
-	auto l = f->GetSize();
-	std::vector<char> buf(l);
-	f->Read(buf.data(), l);
-
 	get_file_chunk_name(nf);
-	return static_cast<StatusCode>(luaL_loadbuffer(lua, buf.data(), l, nf.c_str()));
+	timer.Record(Metrics::Operation::FileLookup, nf, true);
+
+	// Files inside of archives have no modification time, so changes couldn't be detected
+	std::optional<BytecodeCache::FileStamp> stamp {};
+	if(useCache && fReal != nullptr)
+		stamp = BytecodeCache::GetFileStamp(fReal->GetPath());
+
+	std::chrono::nanoseconds readTime {0};
+	auto r = load_chunk(lua, f, nf, mode, timer.IsActive() ? &readTime : nullptr);
+	timer.RecordDuration(Metrics::Operation::FileRead, nf, readTime, true);
+	timer.Record(Metrics::Operation::Parse, nf, r == StatusCode::Ok, readTime);
+	if(r == StatusCode::Ok && stamp) {
+		BytecodeCache::Chunk chunk {};
+		if(dump_bytecode(lua, chunk.bytecode)) {
+			chunk.resolvedPath = fInOut;
+			chunk.chunkName = nf;
+			chunk.diskPath = fReal->GetPath();
+			chunk.stamp = *stamp;
+			bytecodeCache.Insert(cacheKey, std::move(chunk));
+		}
+	}
+	return r;
 }
 
 void Lua::Call(lua_State *lua, int32_t nargs, int32_t nresults) { lua_call(lua, nargs, nresults); }
 
-static Lua::StatusCode protected_call(lua_State *lua, const std::function<Lua::StatusCode(lua_State *)> &pushArgs, int32_t numArgs, int32_t numResults, std::string &outErr, int32_t (*traceback)(lua_State *), void (*pushArgErrorHandler)(lua_State *, Lua::StatusCode))
+static Lua::StatusCode execute_protected_call(lua_State *lua, Lua::PushArgsCallback pushArgs, int32_t numArgs, int32_t numResults, std::string &outErr, int32_t (*traceback)(lua_State *), void (*pushArgErrorHandler)(lua_State *, Lua::StatusCode))
 {
 	int32_t tracebackIdx = 0;
 	if(traceback != nullptr) {
@@ -119,12 +253,12 @@ static Lua::StatusCode protected_call(lua_State *lua, const std::function<Lua::S
 			// push the traceback function before it
 			--tracebackIdx;
 		}
-		lua_pushcfunction(lua, traceback);
+		Lua::push_cached_c_function(lua, traceback);
 		lua_insert(lua, tracebackIdx);
 	}
 	auto top = Lua::GetStackTop(lua);
 	int32_t s = 0;
-	if(pushArgs != nullptr) {
+	if(pushArgs) {
 		auto pushArgStatusCode = pushArgs(lua);
 		s = umath::to_integral(pushArgStatusCode);
 		if(s != 0) {
@@ -150,7 +284,17 @@ static Lua::StatusCode protected_call(lua_State *lua, const std::function<Lua::S
 	}
 
 	numArgs += Lua::GetStackTop(lua) - top;
+	MetricsTimer timer {lua};
+	std::string_view chunkName {};
+	if(timer.IsActive()) {
+		lua_Debug ar;
+		lua_pushvalue(lua, -(numArgs + 1));
+		if(lua_getinfo(lua, ">S", &ar) != 0 && ar.source != nullptr)
+			chunkName = ar.source;
+		timer.Restart();
+	}
 	auto r = lua_pcall(lua, numArgs, numResults, tracebackIdx);
+	timer.Record(Lua::Metrics::Operation::ProtectedCall, chunkName, r == 0);
 	if(traceback != nullptr)
 		Lua::RemoveValue(lua, tracebackIdx);
 	auto statusCode = static_cast<Lua::StatusCode>(r);
@@ -163,11 +307,18 @@ static Lua::StatusCode protected_call(lua_State *lua, const std::function<Lua::S
 
 Lua::StatusCode Lua::ProtectedCall(lua_State *lua, const std::function<StatusCode(lua_State *)> &pushArgs, int32_t numResults, std::string &outErr, int32_t (*traceback)(lua_State *), void (*pushArgErrorHandler)(lua_State *, StatusCode))
 {
-	return protected_call(lua, pushArgs, 0, numResults, outErr, traceback, pushArgErrorHandler);
+	PushArgsCallback callback {};
+	if(pushArgs)
+		callback = PushArgsCallback {pushArgs};
+	return execute_protected_call(lua, callback, 0, numResults, outErr, traceback, pushArgErrorHandler);
+}
+Lua::StatusCode Lua::protected_call(lua_State *lua, PushArgsCallback pushArgs, int32_t numResults, std::string &outErr, int32_t (*traceback)(lua_State *), void (*pushArgErrorHandler)(lua_State *, StatusCode))
+{
+	return execute_protected_call(lua, pushArgs, 0, numResults, outErr, traceback, pushArgErrorHandler);
 }
 Lua::StatusCode Lua::ProtectedCall(lua_State *lua, int32_t nargs, int32_t nresults, std::string &outErr, int32_t (*traceback)(lua_State *), void (*pushArgErrorHandler)(lua_State *, StatusCode))
 {
-	return protected_call(lua, nullptr, nargs, nresults, outErr, traceback, pushArgErrorHandler);
+	return execute_protected_call(lua, {}, nargs, nresults, outErr, traceback, pushArgErrorHandler);
 }
 
 int32_t Lua::CreateTable(lua_State *lua)
@@ -190,6 +341,20 @@ bool Lua::IsUserData(lua_State *lua, int32_t idx) { return (lua_isuserdata(lua,
 
 void Lua::PushBool(lua_State *lua, bool b) { lua_pushboolean(lua, b); }
 void Lua::PushCFunction(lua_State *lua, lua_CFunction f) { lua_pushcfunction(lua, f); }
+void Lua::push_cached_c_function(lua_State *lua, lua_CFunction f)
+{
+	// lua_pushcfunction creates a new function object every time, so we cache it in the registry
+	auto *key = reinterpret_cast<void *>(f);
+	lua_pushlightuserdata(lua, key);
+	lua_rawget(lua, LUA_REGISTRYINDEX);
+	if(lua_isfunction(lua, -1))
+		return;
+	lua_pop(lua, 1);
+	lua_pushcfunction(lua, f);
+	lua_pushlightuserdata(lua, key);
+	lua_pushvalue(lua, -2);
+	lua_rawset(lua, LUA_REGISTRYINDEX);
+}
 void Lua::PushInt(lua_State *lua, ptrdiff_t i) { lua_pushinteger(lua, i); }
 void Lua::PushNil(lua_State *lua) { lua_pushnil(lua); }
 void Lua::PushNumber(lua_State *lua, float f) { lua_pushnumber(lua, f); }
@@ -292,16 +457,25 @@ std::shared_ptr<luabind::module_> Lua::RegisterLibrary(lua_State *l, const std::
 	return std::make_shared<luabind::module_>(luabind::module(l, name.c_str()));
 }
 #endif
-std::shared_ptr<luabind::module_> Lua::RegisterLibrary(lua_State *l, const std::string &name, const std::vector<luaL_Reg> &functions)
-{
-	auto fCpy = functions;
-	if(functions.empty() || functions.back().name != nullptr)
-		fCpy.push_back({nullptr, nullptr});
-#pragma warning(disable : 4309)
-	lua_newtable(l);
-	luaL_setfuncs(l, fCpy.data(), 0);
-#pragma warning(default : 4309)
+std::shared_ptr<luabind::module_> Lua::RegisterLibrary(lua_State *l, const std::string &name, const std::vector<luaL_Reg> &functions) { return register_library(l, name, std::span<const luaL_Reg> {functions}); }
+std::shared_ptr<luabind::module_> Lua::register_library(lua_State *l, const std::string &name, std::span<const luaL_Reg> functions, std::span<const LibraryEnum> enums)
+{
+	if(!functions.empty() && functions.back().name == nullptr)
+		functions = functions.first(functions.size() - 1);
+	lua_createtable(l, 0, static_cast<int>(functions.size() + enums.size()));
+	luaL_checkstack(l, 2, nullptr);
+	for(auto &reg : functions) {
+		lua_pushstring(l, reg.name);
+		lua_pushcfunction(l, reg.func);
+		lua_rawset(l, -3);
+	}
+	for(auto &e : enums) {
+		lua_pushstring(l, e.name);
+		lua_pushinteger(l, e.value);
+		lua_rawset(l, -3);
+	}
 	lua_setglobal(l, name.c_str());
+	invalidate_global_path_handles(l);
 	return std::make_shared<luabind::module_>(luabind::module(l, name.c_str()));
 }
 int32_t Lua::CreateReference(lua_State *lua, int32_t t) { return luaL_ref(lua, t); }
@@ -309,7 +483,19 @@ void Lua::ReleaseReference(lua_State *lua, int32_t ref, int32_t t) { luaL_unref(
 void Lua::Insert(lua_State *lua, int32_t idx) { lua_insert(lua, idx); }
 
 void Lua::GetGlobal(lua_State *lua, const std::string &name) { lua_getglobal(lua, name.c_str()); }
-void Lua::SetGlobal(lua_State *lua, const std::string &name) { lua_setglobal(lua, name.c_str()); }
+void Lua::SetGlobal(lua_State *lua, const std::string &name)
+{
+	// Handles only keep references to tables, so replacing any other value doesn't affect them
+	// Raw, so metamethods of the globals table (e.g. lazy libraries) aren't invoked
+	luaL_checkstack(lua, 1, nullptr);
+	lua_pushlstring(lua, name.data(), name.size());
+	lua_rawget(lua, LUA_GLOBALSINDEX);
+	auto replacesTable = lua_istable(lua, -1);
+	lua_pop(lua, 1);
+	lua_setglobal(lua, name.c_str());
+	if(replacesTable)
+		invalidate_global_path_handles(lua);
+}
 int32_t Lua::GetStackTop(lua_State *lua) { return lua_gettop(lua); }
 void Lua::SetStackTop(lua_State *lua, int32_t idx) { lua_settop(lua, idx); }
 
@@ -322,6 +508,15 @@ void Lua::SetTableValue(lua_State *lua, int32_t idx) { lua_settable(lua, idx); }
 void Lua::GetTableValue(lua_State *lua, int32_t idx) { lua_gettable(lua, idx); }
 void Lua::SetTableValue(lua_State *lua, int32_t idx, int32_t n) { lua_rawseti(lua, idx, n); }
 void Lua::SetRaw(lua_State *lua, int32_t idx) { lua_rawset(lua, idx); }
+bool Lua::is_plain_table(lua_State *lua, int32_t idx)
+{
+	if(lua_type(lua, idx) != LUA_TTABLE)
+		return false;
+	if(lua_getmetatable(lua, idx) == 0)
+		return true;
+	lua_pop(lua, 1);
+	return false;
+}
 std::size_t Lua::GetObjectLength(lua_State *l, const luabind::object &o)
 {
 	o.push(l);
@@ -453,49 +648,95 @@ static std::string GetPathFromFileName(std::string str)
 	return str.substr(0, br + 1);
 }
 
-static std::vector<std::string> s_includeStack;
+namespace {
+	// Keeps the directory of a file on the include stack while it is being executed
+	class IncludeScope {
+	  public:
+		IncludeScope(Lua::LoaderContext &context, std::string path) : m_context {context}, m_prevContext {t_currentLoaderContext}
+		{
+			m_context.includeStack.push_back(std::move(path));
+			t_currentLoaderContext = &m_context;
+		}
+		~IncludeScope()
+		{
+			m_context.includeStack.pop_back();
+			t_currentLoaderContext = m_prevContext;
+		}
+		IncludeScope(const IncludeScope &) = delete;
+		IncludeScope &operator=(const IncludeScope &) = delete;
+	  private:
+		Lua::LoaderContext &m_context;
+		Lua::LoaderContext *m_prevContext = nullptr;
+	};
+}
+
 Lua::StatusCode Lua::ExecuteFile(lua_State *lua, std::string &fInOut, std::string &outErr, int32_t (*traceback)(lua_State *), int32_t numRet, void (*loadErrorHandler)(lua_State *, StatusCode))
 {
 	fInOut = FileManager::GetNormalizedPath(fInOut);
 	auto path = GetPathFromFileName(fInOut);
 	if(!path.empty() && (path.front() == '/' || path.front() == '\\'))
 		path = path.substr(1);
-	s_includeStack.push_back(path);
-	auto s = ProtectedCall(lua, [&fInOut](lua_State *l) { return Lua::LoadFile(l, fInOut); }, numRet, outErr, traceback, loadErrorHandler);
-	s_includeStack.pop_back();
+	IncludeScope includeScope {get_loader_context(lua), std::move(path)};
+	MetricsTimer timer {lua};
+	// Recorded under the same chunk name as the operations of LoadFile and ProtectedCall
+	std::string chunkName;
+	auto s = ProtectedCall(
+	  lua,
+	  [&fInOut, &chunkName, &timer](lua_State *l) {
+		  auto r = Lua::LoadFile(l, fInOut);
+		  if(!timer.IsActive())
+			  return r;
+		  chunkName = get_file_chunk_name(fInOut);
+		  if(r == StatusCode::Ok) {
+			  lua_Debug ar;
+			  lua_pushvalue(l, -1); // lua_getinfo pops the function
+			  if(lua_getinfo(l, ">S", &ar) != 0 && ar.source != nullptr)
+				  chunkName = ar.source;
+		  }
+		  return r;
+	  },
+	  numRet, outErr, traceback, loadErrorHandler);
+	timer.Record(Metrics::Operation::ExecuteFile, chunkName, s == StatusCode::Ok);
 	return s;
 }
 
 Lua::StatusCode Lua::RunString(lua_State *lua, const std::string &str, int32_t retCount, const std::string &chunkName, std::string &outErr, int32_t (*traceback)(lua_State *), void (*loadErrorHandler)(lua_State *, StatusCode))
 {
-	return ProtectedCall(lua, [&str, &chunkName](lua_State *l) { return static_cast<StatusCode>(luaL_loadbuffer(l, str.c_str(), str.length(), chunkName.c_str())); }, retCount, outErr, traceback, loadErrorHandler);
+	MetricsTimer timer {lua};
+	auto r = ProtectedCall(lua, [&str, &chunkName](lua_State *l) { return static_cast<StatusCode>(luaL_loadbuffer(l, str.c_str(), str.length(), chunkName.c_str())); }, retCount, outErr, traceback, loadErrorHandler);
+	timer.Record(Metrics::Operation::RunString, chunkName, r == StatusCode::Ok);
+	return r;
 }
 
 Lua::StatusCode Lua::RunString(lua_State *lua, const std::string &str, const std::string &chunkName, std::string &outErr, int32_t (*traceback)(lua_State *), void (*loadErrorHandler)(lua_State *, StatusCode)) { return RunString(lua, str, 0, chunkName, outErr, traceback, loadErrorHandler); }
 
 void Lua::ExecuteFiles(lua_State *lua, const std::string &subPath, std::string &outErr, int32_t (*traceback)(lua_State *), const std::function<void(StatusCode, const std::string &)> &fCallback)
 {
-	std::string path = SCRIPT_DIRECTORY_SLASH;
-	path += subPath;
-
 	std::vector<std::string> files;
-	if(s_precompiledFilesEnabled)
-		FileManager::FindFiles((path + "*." + FILE_EXTENSION_PRECOMPILED).c_str(), &files, nullptr);
-
-	if(s_precompiledFilesEnabled) {
-		// Add un-compiled lua-files, but only if no compiled version exists
-		std::vector<std::string> rFiles;
-		FileManager::FindFiles((path + "*." + FILE_EXTENSION).c_str(), &rFiles, nullptr);
-		files.reserve(files.size() + rFiles.size());
-		for(auto &fName : rFiles) {
-			auto lname = fName.substr(0, fName.length() - 3) + FILE_EXTENSION_PRECOMPILED;
-			auto it = std::find(files.begin(), files.end(), lname);
-			if(it == files.end())
-				files.push_back(fName);
+	auto &manifest = ScriptManifest::Get();
+	auto precompiledFilesEnabled = are_precompiled_files_enabled(lua);
+	if(manifest.IsEnabled())
+		files = manifest.GetScriptFiles(subPath, precompiledFilesEnabled);
+	else {
+		std::string path = SCRIPT_DIRECTORY_SLASH;
+		path += subPath;
+		if(precompiledFilesEnabled) {
+			FileManager::FindFiles((path + "*." + FILE_EXTENSION_PRECOMPILED).c_str(), &files, nullptr);
+
+			// Add un-compiled lua-files, but only if no compiled version exists
+			std::vector<std::string> rFiles;
+			FileManager::FindFiles((path + "*." + FILE_EXTENSION).c_str(), &rFiles, nullptr);
+			std::unordered_set<std::string> precompiledFiles {files.begin(), files.end()};
+			files.reserve(files.size() + rFiles.size());
+			for(auto &fName : rFiles) {
+				auto lname = fName.substr(0, fName.length() - 3) + FILE_EXTENSION_PRECOMPILED;
+				if(!precompiledFiles.contains(lname))
+					files.push_back(fName);
+			}
 		}
+		else
+			FileManager::FindFiles((path + "*." + FILE_EXTENSION).c_str(), &files, nullptr);
 	}
-	else
-		FileManager::FindFiles((path + "*." + FILE_EXTENSION).c_str(), &files, nullptr);
 
 	for(auto &f : files) {
 		auto path = subPath + f;
@@ -536,19 +777,22 @@ std::string Lua::get_current_file(lua_State *l)
 	return "";
 }
 
-std::string Lua::GetIncludePath(const std::string &f)
+static std::string get_include_path(const Lua::LoaderContext *context, const std::string &f)
 {
 	std::string lf = f;
-	if(!s_includeStack.empty() && (lf.empty() || (lf.front() != '/' && lf.front() != '\\')))
-		lf = s_includeStack.back() + lf;
+	if(context && !context->includeStack.empty() && (lf.empty() || (lf.front() != '/' && lf.front() != '\\')))
+		lf = context->includeStack.back() + lf;
 	return lf;
 }
 
+std::string Lua::GetIncludePath(lua_State *lua, const std::string &f) { return get_include_path(&get_loader_context(lua), f); }
+std::string Lua::GetIncludePath(const std::string &f) { return get_include_path(t_currentLoaderContext, f); }
+
 std::string Lua::GetIncludePath() { return GetIncludePath(""); }
 
 Lua::StatusCode Lua::IncludeFile(lua_State *lua, std::string &fInOut, std::string &outErr, int32_t (*traceback)(lua_State *), int32_t numRet, void (*loadErrorHandler)(lua_State *, StatusCode))
 {
-	fInOut = GetIncludePath(fInOut);
+	fInOut = GetIncludePath(lua, fInOut);
 	return ExecuteFile(lua, fInOut, outErr, traceback, numRet);
 }
 
@@ -632,5 +876,6 @@ luabind::object Lua::WeakReferenceToObject(const luabind::weak_ref &ref)
 }
 
 void Lua::RegisterLibraryEnums(lua_State *l, const std::string &libName, const std::unordered_map<std::string, lua_Integer> &enums) { RegisterLibraryValues(l, libName, enums); }
+void Lua::RegisterLibraryEnums(lua_State *l, const std::string &libName, std::span<const LibraryEnum> enums) { RegisterLibraryValues(l, libName, enums); }
 
 void Lua::GetField(lua_State *l, int32_t idx, const std::string &fieldName) { lua_getfield(l, idx, fieldName.c_str()); }
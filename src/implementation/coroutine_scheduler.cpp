@@ -0,0 +1,380 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :coroutine_scheduler;
+
+static char g_schedulerKey = 0;
+
+Lua::CoroutineScheduler::CoroutineScheduler(lua_State *l, uint32_t maxPooledThreads) : m_state {l}, m_maxPooledThreads {maxPooledThreads}, m_startTime {Clock::now()}
+{
+	m_wheel.fill(INVALID_INDEX);
+	lua_pushlightuserdata(l, &g_schedulerKey);
+	lua_pushlightuserdata(l, this);
+	lua_rawset(l, LUA_REGISTRYINDEX);
+}
+
+Lua::CoroutineScheduler::~CoroutineScheduler()
+{
+	lua_pushlightuserdata(m_state, &g_schedulerKey);
+	lua_pushnil(m_state);
+	lua_rawset(m_state, LUA_REGISTRYINDEX);
+	for(auto &entry : m_entries) {
+		if(entry.state != State::Free)
+			luaL_unref(m_state, LUA_REGISTRYINDEX, entry.threadRef);
+	}
+	for(auto &thread : m_threadPool)
+		luaL_unref(m_state, LUA_REGISTRYINDEX, thread.threadRef);
+}
+
+Lua::CoroutineScheduler *Lua::CoroutineScheduler::Get(lua_State *l)
+{
+	lua_pushlightuserdata(l, &g_schedulerKey);
+	lua_rawget(l, LUA_REGISTRYINDEX);
+	auto *scheduler = static_cast<CoroutineScheduler *>(lua_touserdata(l, -1));
+	lua_pop(l, 1);
+	return scheduler;
+}
+
+Lua::CoroutineScheduler::CoroutineId Lua::CoroutineScheduler::GetId(uint32_t index, uint32_t generation) { return (static_cast<uint64_t>(generation) << 32) | index; }
+
+Lua::CoroutineScheduler::Entry *Lua::CoroutineScheduler::FindEntry(CoroutineId id)
+{
+	auto index = static_cast<uint32_t>(id & std::numeric_limits<uint32_t>::max());
+	if(index >= m_entries.size())
+		return nullptr;
+	auto &entry = m_entries[index];
+	if(entry.state == State::Free || entry.generation != static_cast<uint32_t>(id >> 32))
+		return nullptr;
+	return &entry;
+}
+const Lua::CoroutineScheduler::Entry *Lua::CoroutineScheduler::FindEntry(CoroutineId id) const { return const_cast<CoroutineScheduler *>(this)->FindEntry(id); }
+
+uint32_t Lua::CoroutineScheduler::FindRunningEntry(lua_State *co) const
+{
+	if(m_runningIndex == INVALID_INDEX || m_entries[m_runningIndex].thread != co)
+		return INVALID_INDEX;
+	return m_runningIndex;
+}
+
+bool Lua::CoroutineScheduler::IsAlive(CoroutineId id) const { return FindEntry(id) != nullptr; }
+
+void Lua::CoroutineScheduler::SetState(Entry &entry, State state)
+{
+	auto getCounter = [this](State s) -> uint32_t * {
+		switch(s) {
+		case State::Runnable:
+			return &m_stats.runnable;
+		case State::Sleeping:
+			return &m_stats.sleeping;
+		case State::Suspended:
+			return &m_stats.suspended;
+		}
+		return nullptr;
+	};
+	if(auto *counter = getCounter(entry.state))
+		--*counter;
+	if(auto *counter = getCounter(state))
+		++*counter;
+	if(entry.state == State::Free)
+		++m_stats.live;
+	else if(state == State::Free)
+		--m_stats.live;
+	entry.state = state;
+}
+
+uint32_t Lua::CoroutineScheduler::Create(lua_State *l, int32_t numArgs)
+{
+	PooledThread thread {};
+	if(!m_threadPool.empty()) {
+		thread = m_threadPool.back();
+		m_threadPool.pop_back();
+		--m_stats.pooledThreads;
+		++m_stats.threadsReused;
+	}
+	else {
+		thread.thread = lua_newthread(m_state);
+		thread.threadRef = luaL_ref(m_state, LUA_REGISTRYINDEX);
+	}
+	lua_checkstack(thread.thread, numArgs + 1);
+	lua_xmove(l, thread.thread, numArgs + 1);
+
+	uint32_t index;
+	if(!m_freeEntries.empty()) {
+		index = m_freeEntries.back();
+		m_freeEntries.pop_back();
+	}
+	else {
+		index = static_cast<uint32_t>(m_entries.size());
+		m_entries.push_back({});
+	}
+	auto &entry = m_entries[index];
+	entry.thread = thread.thread;
+	entry.threadRef = thread.threadRef;
+	entry.numArgs = numArgs;
+	return index;
+}
+
+void Lua::CoroutineScheduler::FreeEntry(uint32_t index, bool recycleThread)
+{
+	auto &entry = m_entries[index];
+	if(entry.state == State::Sleeping)
+		UnlinkTimer(index);
+	SetState(entry, State::Free);
+	if(++entry.generation == 0)
+		entry.generation = 1;
+	// Threads can only be reused if they're not suspended and haven't been terminated by an error
+	if(recycleThread && lua_status(entry.thread) == 0 && m_threadPool.size() < m_maxPooledThreads) {
+		lua_settop(entry.thread, 0);
+		m_threadPool.push_back({entry.thread, entry.threadRef});
+		++m_stats.pooledThreads;
+	}
+	else
+		luaL_unref(m_state, LUA_REGISTRYINDEX, entry.threadRef);
+	entry.thread = nullptr;
+	entry.threadRef = LUA_NOREF;
+	entry.numArgs = 0;
+	m_freeEntries.push_back(index);
+}
+
+void Lua::CoroutineScheduler::MakeRunnable(uint32_t index)
+{
+	auto &entry = m_entries[index];
+	SetState(entry, State::Runnable);
+	m_runQueue.emplace_back(index, entry.generation);
+}
+
+Lua::CoroutineScheduler::CoroutineId Lua::CoroutineScheduler::Spawn(lua_State *l, int32_t numArgs)
+{
+	auto index = Create(l, numArgs);
+	MakeRunnable(index);
+	return GetId(index, m_entries[index].generation);
+}
+
+Lua::CoroutineScheduler::CoroutineId Lua::CoroutineScheduler::SpawnDelayed(lua_State *l, std::chrono::milliseconds delay, int32_t numArgs)
+{
+	auto index = Create(l, numArgs);
+	auto &entry = m_entries[index];
+	SetState(entry, State::Sleeping);
+	ScheduleTimer(index, GetWakeTick(delay));
+	return GetId(index, entry.generation);
+}
+
+bool Lua::CoroutineScheduler::Wake(CoroutineId id)
+{
+	auto *entry = FindEntry(id);
+	if(entry == nullptr || (entry->state != State::Sleeping && entry->state != State::Suspended))
+		return false;
+	auto index = static_cast<uint32_t>(entry - m_entries.data());
+	if(entry->state == State::Sleeping)
+		UnlinkTimer(index);
+	MakeRunnable(index);
+	return true;
+}
+
+bool Lua::CoroutineScheduler::Kill(CoroutineId id)
+{
+	auto *entry = FindEntry(id);
+	if(entry == nullptr || entry->state == State::Running)
+		return false;
+	// Entries in the run queue are skipped due to the generation change
+	FreeEntry(static_cast<uint32_t>(entry - m_entries.data()), true);
+	return true;
+}
+
+uint64_t Lua::CoroutineScheduler::GetWakeTick(std::chrono::milliseconds delay) const
+{
+	auto now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - m_startTime) / TICK_DURATION);
+	auto ticks = static_cast<uint64_t>(std::max<int64_t>(delay / TICK_DURATION, 0));
+	// Timers are only processed for ticks after the current one
+	return std::max(now + ticks, m_currentTick + 1);
+}
+
+int32_t Lua::CoroutineScheduler::Wait(lua_State *co, std::chrono::milliseconds duration)
+{
+	auto index = FindRunningEntry(co);
+	if(index == INVALID_INDEX)
+		return luaL_error(co, "attempt to wait outside of a scheduled coroutine");
+	SetState(m_entries[index], State::Sleeping);
+	ScheduleTimer(index, GetWakeTick(duration));
+	return lua_yield(co, 0);
+}
+
+int32_t Lua::CoroutineScheduler::Suspend(lua_State *co)
+{
+	auto index = FindRunningEntry(co);
+	if(index == INVALID_INDEX)
+		return luaL_error(co, "attempt to suspend outside of a scheduled coroutine");
+	SetState(m_entries[index], State::Suspended);
+	return lua_yield(co, 0);
+}
+
+int32_t Lua::CoroutineScheduler::LuaWait(lua_State *l)
+{
+	auto *scheduler = Get(l);
+	if(scheduler == nullptr)
+		return luaL_error(l, "no coroutine scheduler");
+	auto seconds = luaL_checknumber(l, 1);
+	return scheduler->Wait(l, std::chrono::milliseconds {static_cast<int64_t>(std::max(seconds, 0.0) * 1000.0)});
+}
+
+int32_t Lua::CoroutineScheduler::LuaSuspend(lua_State *l)
+{
+	auto *scheduler = Get(l);
+	if(scheduler == nullptr)
+		return luaL_error(l, "no coroutine scheduler");
+	return scheduler->Suspend(l);
+}
+
+void Lua::CoroutineScheduler::Resume(uint32_t index)
+{
+	auto &entry = m_entries[index];
+	auto *co = entry.thread;
+	auto numArgs = entry.numArgs;
+	entry.numArgs = 0;
+	SetState(entry, State::Running);
+	auto prevRunningIndex = m_runningIndex;
+	m_runningIndex = index;
+	++m_stats.resumes;
+	auto r = lua_resume(co, numArgs);
+	m_runningIndex = prevRunningIndex;
+
+	// The coroutine may have spawned new coroutines, so the entry reference may have been invalidated
+	auto &resumedEntry = m_entries[index];
+	switch(r) {
+	case LUA_YIELD:
+		// Yielded values are discarded
+		lua_settop(co, 0);
+		if(resumedEntry.state == State::Running)
+			MakeRunnable(index); // Regular yield, resume in the next update
+		break;
+	case 0:
+		++m_stats.completed;
+		FreeEntry(index, true);
+		break;
+	default:
+		{
+			++m_stats.errors;
+			if(m_errorHandler) {
+				auto *msg = lua_tostring(co, -1);
+				m_errorHandler(GetId(index, resumedEntry.generation), (msg != nullptr) ? msg : "unknown error");
+			}
+			FreeEntry(index, false);
+			break;
+		}
+	}
+}
+
+uint32_t Lua::CoroutineScheduler::Update(uint32_t maxResumes) { return Update(Clock::now(), maxResumes); }
+
+uint32_t Lua::CoroutineScheduler::Update(Clock::time_point now, uint32_t maxResumes)
+{
+	auto targetTick = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now - m_startTime) / TICK_DURATION);
+	while(m_currentTick < targetTick) {
+		if(m_stats.sleeping == 0) {
+			// Nothing to wake up, we can skip ahead
+			m_currentTick = targetTick;
+			break;
+		}
+		AdvanceTick();
+	}
+
+	// Coroutines that become runnable during this update are resumed in the next one
+	auto numQueued = m_runQueue.size();
+	uint32_t numResumed = 0;
+	for(size_t i = 0; i < numQueued && numResumed < maxResumes; ++i) {
+		auto [index, generation] = m_runQueue.front();
+		m_runQueue.pop_front();
+		auto &entry = m_entries[index];
+		if(entry.generation != generation || entry.state != State::Runnable)
+			continue;
+		Resume(index);
+		++numResumed;
+	}
+	return numResumed;
+}
+
+void Lua::CoroutineScheduler::SetErrorHandler(const ErrorHandler &errorHandler) { m_errorHandler = errorHandler; }
+const Lua::CoroutineScheduler::Stats &Lua::CoroutineScheduler::GetStats() const { return m_stats; }
+
+void Lua::CoroutineScheduler::ScheduleTimer(uint32_t index, uint64_t wakeTick)
+{
+	constexpr uint64_t maxDelta = (uint64_t {1} << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+	auto delta = (wakeTick > m_currentTick) ? (wakeTick - m_currentTick) : 0;
+	if(delta > maxDelta) {
+		delta = maxDelta;
+		wakeTick = m_currentTick + maxDelta;
+	}
+	uint32_t level = 0;
+	while(level < WHEEL_LEVELS - 1 && delta >= (uint64_t {1} << (WHEEL_BITS * (level + 1))))
+		++level;
+	auto slot = level * WHEEL_SLOTS + static_cast<uint32_t>((wakeTick >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+
+	auto &entry = m_entries[index];
+	entry.wakeTick = wakeTick;
+	entry.slot = slot;
+	entry.prev = INVALID_INDEX;
+	entry.next = m_wheel[slot];
+	if(entry.next != INVALID_INDEX)
+		m_entries[entry.next].prev = index;
+	m_wheel[slot] = index;
+}
+
+void Lua::CoroutineScheduler::UnlinkTimer(uint32_t index)
+{
+	auto &entry = m_entries[index];
+	if(entry.slot == INVALID_INDEX)
+		return;
+	if(entry.prev != INVALID_INDEX)
+		m_entries[entry.prev].next = entry.next;
+	else
+		m_wheel[entry.slot] = entry.next;
+	if(entry.next != INVALID_INDEX)
+		m_entries[entry.next].prev = entry.prev;
+	entry.slot = INVALID_INDEX;
+	entry.prev = INVALID_INDEX;
+	entry.next = INVALID_INDEX;
+}
+
+uint32_t Lua::CoroutineScheduler::Cascade(uint32_t level)
+{
+	auto slotIndex = static_cast<uint32_t>((m_currentTick >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+	auto &head = m_wheel[level * WHEEL_SLOTS + slotIndex];
+	auto index = head;
+	head = INVALID_INDEX;
+	while(index != INVALID_INDEX) {
+		auto next = m_entries[index].next;
+		ScheduleTimer(index, m_entries[index].wakeTick);
+		index = next;
+	}
+	return slotIndex;
+}
+
+void Lua::CoroutineScheduler::AdvanceTick()
+{
+	++m_currentTick;
+	if((m_currentTick & (WHEEL_SLOTS - 1)) == 0) {
+		// Move the timers of the next window of each level down, until we reach a level that hasn't wrapped around
+		for(uint32_t level = 1; level < WHEEL_LEVELS; ++level) {
+			if(Cascade(level) != 0)
+				break;
+		}
+	}
+	auto &head = m_wheel[m_currentTick & (WHEEL_SLOTS - 1)];
+	auto index = head;
+	head = INVALID_INDEX;
+	while(index != INVALID_INDEX) {
+		auto &entry = m_entries[index];
+		auto next = entry.next;
+		entry.slot = INVALID_INDEX;
+		entry.prev = INVALID_INDEX;
+		entry.next = INVALID_INDEX;
+		MakeRunnable(index);
+		index = next;
+	}
+}
@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :garbage_collector;
+
+// Weight of new measurements for the moving averages
+static constexpr double SMOOTHING_FACTOR = 0.2;
+
+Lua::GarbageCollector::GarbageCollector(lua_State *l) : m_state {l}, m_lastStepTime {std::chrono::steady_clock::now()}
+{
+	// There is no way to query the parameters without changing them
+	m_stats.pause = lua_gc(l, LUA_GCSETPAUSE, 200);
+	m_stats.stepMultiplier = lua_gc(l, LUA_GCSETSTEPMUL, 200);
+	ApplyParameters();
+	m_lastHeapSizeKb = GetHeapSizeKb();
+	m_stats.heapSizeKb = m_lastHeapSizeKb;
+}
+
+double Lua::GarbageCollector::GetHeapSizeKb() const { return lua_gc(m_state, LUA_GCCOUNT, 0) + lua_gc(m_state, LUA_GCCOUNTB, 0) / 1024.0; }
+
+void Lua::GarbageCollector::SetSettings(const Settings &settings)
+{
+	m_settings = settings;
+	ApplyParameters();
+}
+const Lua::GarbageCollector::Settings &Lua::GarbageCollector::GetSettings() const { return m_settings; }
+const Lua::GarbageCollector::Stats &Lua::GarbageCollector::GetStats() const { return m_stats; }
+
+void Lua::GarbageCollector::ApplyParameters()
+{
+	if(m_settings.adaptive) {
+		m_stats.pause = std::clamp(m_stats.pause, m_settings.minPause, std::max(m_settings.maxPause, m_settings.minPause));
+		m_stats.stepMultiplier = std::clamp(m_stats.stepMultiplier, m_settings.minStepMultiplier, std::max(m_settings.maxStepMultiplier, m_settings.minStepMultiplier));
+	}
+	lua_gc(m_state, LUA_GCSETPAUSE, m_stats.pause);
+	lua_gc(m_state, LUA_GCSETSTEPMUL, m_stats.stepMultiplier);
+}
+
+void Lua::GarbageCollector::Adapt(bool budgetExhausted)
+{
+	if(budgetExhausted && m_stats.heapTrendKbPerSecond > 0.0) {
+		// The collector can't keep up with the allocations, start cycles earlier and do more work per step
+		m_stats.stepMultiplier = m_stats.stepMultiplier + std::max(m_stats.stepMultiplier / 4, 1);
+		m_stats.pause -= 10;
+	}
+	else if(m_stats.heapTrendKbPerSecond <= 0.0) {
+		m_stats.stepMultiplier -= m_stats.stepMultiplier / 10;
+		m_stats.pause += 5;
+	}
+	else
+		return;
+	ApplyParameters();
+}
+
+bool Lua::GarbageCollector::Step(std::chrono::microseconds budget)
+{
+	if(budget.count() <= 0)
+		return false;
+	auto tStart = std::chrono::steady_clock::now();
+	auto heapSizeBefore = GetHeapSizeKb();
+	auto dt = std::chrono::duration<double>(tStart - m_lastStepTime).count();
+	if(dt > 0.0) {
+		auto allocationRate = std::max(heapSizeBefore - m_lastHeapSizeKb, 0.0) / dt;
+		m_stats.allocationRateKbPerSecond += (allocationRate - m_stats.allocationRateKbPerSecond) * SMOOTHING_FACTOR;
+	}
+
+	auto tEnd = tStart + budget;
+	auto t = tStart;
+	std::chrono::nanoseconds maxStepDuration {0};
+	auto cycleCompleted = false;
+	// Stop once the next step would likely exceed the budget
+	do {
+		auto res = lua_gc(m_state, LUA_GCSTEP, m_settings.stepSizeKb);
+		auto tStep = std::chrono::steady_clock::now();
+		auto stepDuration = std::chrono::duration_cast<std::chrono::nanoseconds>(tStep - t);
+		t = tStep;
+		++m_stats.steps;
+		maxStepDuration = std::max(maxStepDuration, stepDuration);
+		m_stats.averageStepDuration += std::chrono::nanoseconds {static_cast<int64_t>((stepDuration - m_stats.averageStepDuration).count() * SMOOTHING_FACTOR)};
+		if(res != 0) {
+			cycleCompleted = true;
+			++m_stats.completedCycles;
+			break;
+		}
+	} while(t + m_stats.averageStepDuration < tEnd);
+
+	auto heapSizeAfter = GetHeapSizeKb();
+	m_stats.lastDuration = std::chrono::duration_cast<std::chrono::nanoseconds>(t - tStart);
+	m_stats.lastMaxStepDuration = maxStepDuration;
+	m_stats.lastFreedKb = std::max(heapSizeBefore - heapSizeAfter, 0.0);
+	m_stats.totalFreedKb += m_stats.lastFreedKb;
+	m_stats.heapSizeKb = heapSizeAfter;
+	if(dt > 0.0)
+		m_stats.heapTrendKbPerSecond += ((heapSizeAfter - m_lastHeapSizeKb) / dt - m_stats.heapTrendKbPerSecond) * SMOOTHING_FACTOR;
+	m_lastHeapSizeKb = heapSizeAfter;
+	m_lastStepTime = t;
+
+	if(m_settings.adaptive)
+		Adapt(!cycleCompleted);
+	return cycleCompleted;
+}
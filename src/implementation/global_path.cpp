@@ -0,0 +1,157 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :core;
+import :global_path;
+
+struct Lua::GlobalPathHandle::StateInfo {
+	uint64_t generation = 1;
+	// Set once the lua state has been closed, after which the references are gone
+	bool closed = false;
+	// Thread that is anchored in the registry, used to release references after the thread
+	// that resolved the handle (e.g. a coroutine) has been collected
+	lua_State *thread = nullptr;
+};
+
+static char g_globalPathStateKey = 0;
+static char g_globalPathThreadKey = 0;
+
+namespace {
+	// Userdata that ties the state info to the lifetime of the lua state
+	struct StateInfoOwner {
+		std::shared_ptr<Lua::GlobalPathHandle::StateInfo> info;
+	};
+}
+
+static int32_t destroy_state_info(lua_State *l)
+{
+	auto *owner = static_cast<StateInfoOwner *>(lua_touserdata(l, 1));
+	owner->info->closed = true;
+	owner->info->thread = nullptr;
+	owner->~StateInfoOwner();
+	return 0;
+}
+
+const std::shared_ptr<Lua::GlobalPathHandle::StateInfo> *Lua::GlobalPathHandle::FindStateInfo(lua_State *l)
+{
+	lua_pushlightuserdata(l, &g_globalPathStateKey);
+	lua_rawget(l, LUA_REGISTRYINDEX);
+	auto *owner = static_cast<StateInfoOwner *>(lua_touserdata(l, -1));
+	lua_pop(l, 1);
+	return owner ? &owner->info : nullptr;
+}
+
+const std::shared_ptr<Lua::GlobalPathHandle::StateInfo> &Lua::GlobalPathHandle::GetStateInfo(lua_State *l)
+{
+	if(auto *info = FindStateInfo(l))
+		return *info;
+	luaL_checkstack(l, 3, nullptr);
+	auto *owner = new(lua_newuserdata(l, sizeof(StateInfoOwner))) StateInfoOwner {std::make_shared<StateInfo>()};
+	lua_createtable(l, 0, 1);
+	lua_pushcfunction(l, destroy_state_info);
+	lua_setfield(l, -2, "__gc");
+	lua_setmetatable(l, -2);
+	lua_pushlightuserdata(l, &g_globalPathStateKey);
+	lua_insert(l, -2);
+	lua_rawset(l, LUA_REGISTRYINDEX);
+
+	lua_pushlightuserdata(l, &g_globalPathThreadKey);
+	owner->info->thread = lua_newthread(l);
+	lua_rawset(l, LUA_REGISTRYINDEX);
+	return owner->info;
+}
+
+void Lua::invalidate_global_path_handles(lua_State *l)
+{
+	// Without state info, no handle has been resolved with this state yet
+	if(auto *info = GlobalPathHandle::FindStateInfo(l))
+		++(*info)->generation;
+}
+uint64_t Lua::get_global_path_generation(lua_State *l)
+{
+	auto *info = GlobalPathHandle::FindStateInfo(l);
+	return info ? (*info)->generation : 0;
+}
+
+Lua::GlobalPathHandle::GlobalPathHandle(std::string path) : m_path {std::move(path)} {}
+Lua::GlobalPathHandle::~GlobalPathHandle() { Release(); }
+
+const std::string &Lua::GlobalPathHandle::GetPath() const { return m_path; }
+
+void Lua::GlobalPathHandle::Release()
+{
+	if(m_stateInfo == nullptr)
+		return;
+	if(!m_stateInfo->closed) {
+		luaL_unref(m_stateInfo->thread, LUA_REGISTRYINDEX, m_parentRef);
+		luaL_unref(m_stateInfo->thread, LUA_REGISTRYINDEX, m_keyRef);
+	}
+	m_parentRef = LUA_NOREF;
+	m_keyRef = LUA_NOREF;
+	m_stateInfo = nullptr;
+	m_generation = 0;
+}
+
+void Lua::GlobalPathHandle::Invalidate() { m_generation = 0; }
+
+bool Lua::GlobalPathHandle::Resolve(lua_State *l)
+{
+	Release();
+	std::string_view path {m_path};
+	auto sep = path.find_last_of('.');
+	if(sep == std::string_view::npos)
+		lua_pushvalue(l, LUA_GLOBALSINDEX);
+	else
+		get_global_nested_library(l, path.substr(0, sep));
+	if(!lua_istable(l, -1)) {
+		lua_pop(l, 1);
+		return false;
+	}
+	m_stateInfo = GetStateInfo(l);
+	m_parentRef = luaL_ref(l, LUA_REGISTRYINDEX);
+	auto key = (sep == std::string_view::npos) ? path : path.substr(sep + 1);
+	lua_pushlstring(l, key.data(), key.size());
+	m_keyRef = luaL_ref(l, LUA_REGISTRYINDEX);
+	m_generation = m_stateInfo->generation;
+	return true;
+}
+
+// Arguments: table, key
+static int32_t get_table_value(lua_State *l)
+{
+	lua_settop(l, 2);
+	lua_gettable(l, 1);
+	return 1;
+}
+
+void Lua::GlobalPathHandle::Push(lua_State *l)
+{
+	// The state info is shared by all threads of a lua state, so this also detects handles that are used with a different state
+	auto *info = FindStateInfo(l);
+	if((info == nullptr || info->get() != m_stateInfo.get() || m_generation != m_stateInfo->generation) && !Resolve(l)) {
+		lua_pushnil(l);
+		return;
+	}
+	lua_rawgeti(l, LUA_REGISTRYINDEX, m_parentRef);
+	lua_rawgeti(l, LUA_REGISTRYINDEX, m_keyRef);
+	lua_rawget(l, -2);
+	if(lua_isnil(l, -1)) {
+		// The value may be provided by an __index metamethod, which may raise an error (e.g. strict mode globals)
+		lua_pop(l, 1);
+		luaL_checkstack(l, 3, nullptr);
+		lua_pushcfunction(l, get_table_value);
+		lua_pushvalue(l, -2);
+		lua_rawgeti(l, LUA_REGISTRYINDEX, m_keyRef);
+		if(lua_pcall(l, 2, 1, 0) != 0) {
+			lua_pop(l, 1);
+			lua_pushnil(l);
+		}
+	}
+	lua_remove(l, -2);
+}
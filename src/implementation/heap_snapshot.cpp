@@ -0,0 +1,729 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :heap_snapshot;
+
+namespace {
+	// Rough object sizes of the lua runtime, used to estimate the memory footprint of objects
+	constexpr uint32_t TABLE_HEADER_SIZE = 64;
+	constexpr uint32_t TABLE_ARRAY_SLOT_SIZE = 8;
+	constexpr uint32_t TABLE_NODE_SIZE = 24;
+	constexpr uint32_t FUNCTION_HEADER_SIZE = 40;
+	constexpr uint32_t UPVALUE_SIZE = 8;
+	// Closed upvalue of a lua function. Upvalues that are shared between closures are counted for each of them.
+	constexpr uint32_t UPVALUE_OBJECT_SIZE = 40;
+	// Upvalues of C functions are stored in the closure itself
+	constexpr uint32_t C_UPVALUE_SIZE = 8;
+	constexpr uint32_t STRING_HEADER_SIZE = 24;
+	constexpr uint32_t USERDATA_HEADER_SIZE = 40;
+	constexpr uint32_t THREAD_HEADER_SIZE = 128;
+	constexpr uint32_t STACK_SLOT_SIZE = 8;
+
+	class SnapshotBuilder {
+	  public:
+		SnapshotBuilder(lua_State *l, lua::HeapSnapshot &snapshot) : m_state {l}, m_snapshot {snapshot} {}
+		void Build();
+	  private:
+		// Pops the value at the top of the stack of 'from' and records it as a child of 'parent'
+		void Visit(lua_State *from, uint32_t parent, const std::string_view &desc);
+		void Expand(uint32_t objectIndex);
+		void ExpandTable(uint32_t objectIndex);
+		void ExpandUserData(uint32_t objectIndex);
+		void ExpandFunction(uint32_t objectIndex);
+		void ExpandThread(uint32_t objectIndex);
+		uint32_t GetDescription(const std::string_view &desc);
+		const char *GetKeyDescription(int idx, char *buffer, size_t size);
+
+		lua_State *m_state;
+		lua::HeapSnapshot &m_snapshot;
+		// Objects that have been discovered, but not expanded yet, are kept in a lua table instead of on the
+		// C or lua stack, so arbitrarily deep object graphs can be traversed.
+		int m_pendingTableIdx = 0;
+		std::vector<uint32_t> m_pending;
+		std::unordered_map<const void *, uint32_t> m_objectIndices;
+		struct DescriptionHash {
+			using is_transparent = void;
+			size_t operator()(const std::string_view &desc) const { return std::hash<std::string_view> {}(desc); }
+		};
+		// Looked up by std::string_view, so a string only has to be allocated for new descriptions
+		std::unordered_map<std::string, uint32_t, DescriptionHash, std::equal_to<>> m_descriptionIndices;
+	};
+}
+
+uint32_t SnapshotBuilder::GetDescription(const std::string_view &desc)
+{
+	auto it = m_descriptionIndices.find(desc);
+	if(it != m_descriptionIndices.end())
+		return it->second;
+	auto idx = static_cast<uint32_t>(m_snapshot.descriptions.size());
+	m_snapshot.descriptions.emplace_back(desc);
+	m_descriptionIndices.emplace(m_snapshot.descriptions.back(), idx);
+	return idx;
+}
+
+const char *SnapshotBuilder::GetKeyDescription(int idx, char *buffer, size_t size)
+{
+	auto t = lua_type(m_state, idx);
+	switch(t) {
+	case LUA_TSTRING:
+		return lua_tostring(m_state, idx);
+	case LUA_TNUMBER:
+		snprintf(buffer, size, "[%lg]", lua_tonumber(m_state, idx));
+		break;
+	case LUA_TBOOLEAN:
+		snprintf(buffer, size, "[%s]", lua_toboolean(m_state, idx) ? "true" : "false");
+		break;
+	default:
+		snprintf(buffer, size, "[%s]", lua_typename(m_state, t));
+		break;
+	}
+	return buffer;
+}
+
+void SnapshotBuilder::Visit(lua_State *from, uint32_t parent, const std::string_view &desc)
+{
+	lua::HeapSnapshot::ObjectType type;
+	switch(lua_type(from, -1)) {
+	case LUA_TTABLE:
+		type = lua::HeapSnapshot::ObjectType::Table;
+		break;
+	case LUA_TFUNCTION:
+		type = lua::HeapSnapshot::ObjectType::Function;
+		break;
+	case LUA_TTHREAD:
+		type = lua::HeapSnapshot::ObjectType::Thread;
+		break;
+	case LUA_TUSERDATA:
+		type = lua::HeapSnapshot::ObjectType::UserData;
+		break;
+	case LUA_TSTRING:
+		type = lua::HeapSnapshot::ObjectType::String;
+		break;
+	default:
+		lua_pop(from, 1);
+		return;
+	}
+	// Strings are interned, so their contents identify them
+	size_t strLen = 0;
+	auto *p = (type == lua::HeapSnapshot::ObjectType::String) ? static_cast<const void *>(lua_tolstring(from, -1, &strLen)) : lua_topointer(from, -1);
+	auto edgeIdx = static_cast<uint32_t>(m_snapshot.edges.size());
+	auto it = m_objectIndices.find(p);
+	if(it != m_objectIndices.end()) {
+		if(it->second != lua::HeapSnapshot::INVALID_INDEX)
+			m_snapshot.edges.push_back({parent, it->second, GetDescription(desc)});
+		lua_pop(from, 1);
+		return;
+	}
+	auto objectIdx = static_cast<uint32_t>(m_snapshot.objects.size());
+	m_objectIndices.insert(std::make_pair(p, objectIdx));
+	m_snapshot.objects.push_back({reinterpret_cast<uint64_t>(p), 0, edgeIdx, type});
+	m_snapshot.edges.push_back({parent, objectIdx, GetDescription(desc)});
+
+	if(type == lua::HeapSnapshot::ObjectType::String) {
+		// Strings don't reference other objects and don't need to be expanded
+		m_snapshot.objects[objectIdx].size = STRING_HEADER_SIZE + static_cast<uint32_t>(strLen) + 1;
+		lua_pop(from, 1);
+		return;
+	}
+	if(from != m_state)
+		lua_xmove(from, m_state, 1);
+	m_pending.push_back(objectIdx);
+	lua_rawseti(m_state, m_pendingTableIdx, static_cast<int>(m_pending.size()));
+}
+
+void SnapshotBuilder::ExpandTable(uint32_t objectIndex)
+{
+	auto *l = m_state;
+	auto weakKeys = false;
+	auto weakValues = false;
+	if(lua_getmetatable(l, -1)) {
+		lua_pushliteral(l, "__mode");
+		lua_rawget(l, -2);
+		if(lua_isstring(l, -1)) {
+			auto *mode = lua_tostring(l, -1);
+			weakKeys = (strchr(mode, 'k') != nullptr);
+			weakValues = (strchr(mode, 'v') != nullptr);
+		}
+		lua_pop(l, 1);
+		Visit(l, objectIndex, "[metatable]");
+	}
+
+	uint32_t numEntries = 0;
+	lua_pushnil(l);
+	while(lua_next(l, -2) != 0) {
+		++numEntries;
+		if(weakValues)
+			lua_pop(l, 1);
+		else {
+			char buffer[32];
+			auto *desc = GetKeyDescription(-2, buffer, sizeof(buffer));
+			Visit(l, objectIndex, desc);
+		}
+		if(!weakKeys) {
+			lua_pushvalue(l, -1);
+			Visit(l, objectIndex, "[key]");
+		}
+	}
+	auto arraySize = static_cast<uint32_t>(lua_objlen(l, -1));
+	// The hash part always has a power-of-two number of nodes
+	auto hashEntries = (numEntries > arraySize) ? (numEntries - arraySize) : 0;
+	auto hashSize = (hashEntries > 0) ? std::bit_ceil(hashEntries) : 0;
+	m_snapshot.objects[objectIndex].size = TABLE_HEADER_SIZE + arraySize * TABLE_ARRAY_SLOT_SIZE + hashSize * TABLE_NODE_SIZE;
+}
+
+void SnapshotBuilder::ExpandUserData(uint32_t objectIndex)
+{
+	auto *l = m_state;
+	m_snapshot.objects[objectIndex].size = USERDATA_HEADER_SIZE + static_cast<uint32_t>(lua_objlen(l, -1));
+	if(lua_getmetatable(l, -1))
+		Visit(l, objectIndex, "[metatable]");
+	lua_getfenv(l, -1);
+	Visit(l, objectIndex, "[uservalue]");
+}
+
+void SnapshotBuilder::ExpandFunction(uint32_t objectIndex)
+{
+	auto *l = m_state;
+	auto isCFunction = lua_iscfunction(l, -1);
+	lua_getfenv(l, -1);
+	Visit(l, objectIndex, "[environment]");
+	uint32_t numUpvalues = 0;
+	for(auto i = 1;; ++i) {
+		auto *name = lua_getupvalue(l, -1, i);
+		if(name == nullptr)
+			break;
+		++numUpvalues;
+		Visit(l, objectIndex, name[0] ? name : "[upvalue]");
+	}
+	m_snapshot.objects[objectIndex].size = FUNCTION_HEADER_SIZE + numUpvalues * (isCFunction ? C_UPVALUE_SIZE : (UPVALUE_SIZE + UPVALUE_OBJECT_SIZE));
+}
+
+void SnapshotBuilder::ExpandThread(uint32_t objectIndex)
+{
+	auto *l = m_state;
+	auto *cL = lua_tothread(l, -1);
+	auto level = 0;
+	auto top = 0;
+	if(cL == l)
+		level = 1;
+	else {
+		top = lua_gettop(cL);
+		luaL_checkstack(cL, 1, nullptr);
+		char desc[16];
+		for(auto i = 1; i <= top; ++i) {
+			lua_pushvalue(cL, i);
+			snprintf(desc, sizeof(desc), "[%d]", i);
+			Visit(cL, objectIndex, desc);
+		}
+	}
+	m_snapshot.objects[objectIndex].size = THREAD_HEADER_SIZE + top * STACK_SLOT_SIZE;
+
+	lua_Debug ar;
+	char desc[128];
+	while(lua_getstack(cL, level, &ar)) {
+		lua_getinfo(cL, "Sl", &ar);
+		for(auto i = 1;; ++i) {
+			auto *name = lua_getlocal(cL, &ar, i);
+			if(name == nullptr)
+				break;
+			snprintf(desc, sizeof(desc), "%s : %s:%d", name, ar.short_src, ar.currentline);
+			Visit(cL, objectIndex, desc);
+		}
+		++level;
+	}
+}
+
+void SnapshotBuilder::Expand(uint32_t objectIndex)
+{
+	switch(m_snapshot.objects[objectIndex].type) {
+	case lua::HeapSnapshot::ObjectType::Table:
+		ExpandTable(objectIndex);
+		break;
+	case lua::HeapSnapshot::ObjectType::UserData:
+		ExpandUserData(objectIndex);
+		break;
+	case lua::HeapSnapshot::ObjectType::Function:
+		ExpandFunction(objectIndex);
+		break;
+	case lua::HeapSnapshot::ObjectType::Thread:
+		ExpandThread(objectIndex);
+		break;
+	default:
+		break;
+	}
+}
+
+void SnapshotBuilder::Build()
+{
+	auto *l = m_state;
+	auto top = lua_gettop(l);
+	luaL_checkstack(l, LUA_MINSTACK, nullptr);
+	lua_newtable(l);
+	m_pendingTableIdx = lua_gettop(l);
+	// The pending table is a temporary object and must not show up in the snapshot
+	m_objectIndices.insert(std::make_pair(lua_topointer(l, -1), lua::HeapSnapshot::INVALID_INDEX));
+
+	lua_pushvalue(l, LUA_REGISTRYINDEX);
+	Visit(l, lua::HeapSnapshot::INVALID_INDEX, "[registry]");
+	while(!m_pending.empty()) {
+		auto n = static_cast<int>(m_pending.size());
+		auto objectIndex = m_pending.back();
+		m_pending.pop_back();
+		lua_rawgeti(l, m_pendingTableIdx, n);
+		lua_pushnil(l);
+		lua_rawseti(l, m_pendingTableIdx, n);
+		Expand(objectIndex);
+		lua_settop(l, m_pendingTableIdx);
+	}
+	lua_settop(l, top);
+}
+
+lua::HeapSnapshot lua::HeapSnapshot::Capture(lua_State *l)
+{
+	HeapSnapshot snapshot {};
+	SnapshotBuilder builder {l, snapshot};
+	builder.Build();
+	return snapshot;
+}
+
+std::string lua::HeapSnapshot::GetPath(uint32_t objectIndex) const
+{
+	std::vector<uint32_t> chain;
+	while(objectIndex != INVALID_INDEX && objectIndex < objects.size()) {
+		auto edgeIdx = objects[objectIndex].parentEdge;
+		if(edgeIdx == INVALID_INDEX)
+			break;
+		auto &edge = edges[edgeIdx];
+		chain.push_back(edge.description);
+		objectIndex = edge.parent;
+	}
+	std::string path;
+	for(auto it = chain.rbegin(); it != chain.rend(); ++it) {
+		if(!path.empty())
+			path += '.';
+		path += descriptions[*it];
+	}
+	return path;
+}
+
+uint64_t lua::HeapSnapshot::GetTotalSize() const
+{
+	uint64_t size = 0;
+	for(auto &o : objects)
+		size += o.size;
+	return size;
+}
+
+namespace {
+	// Compressed sparse row representation of the successors or predecessors of every node
+	struct Adjacency {
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> nodes;
+		std::span<const uint32_t> Get(uint32_t node) const { return {nodes.data() + offsets[node], nodes.data() + offsets[node + 1]}; }
+	};
+
+	// Lengauer-Tarjan with path compression. All recursion is replaced by explicit stacks, so the depth of the graph is not limited.
+	class DominatorTree {
+	  public:
+		static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+		DominatorTree(const Adjacency &successors, const Adjacency &predecessors, uint32_t root) : m_successors {successors}, m_predecessors {predecessors}, m_root {root} {}
+		// Returns the immediate dominator of every node (NONE for the root and unreachable nodes), as well as the nodes in DFS order
+		void Compute(std::vector<uint32_t> &outIdom, std::vector<uint32_t> &outOrder);
+	  private:
+		void Search();
+		uint32_t Eval(uint32_t v);
+
+		const Adjacency &m_successors;
+		const Adjacency &m_predecessors;
+		uint32_t m_root;
+		// Indexed by node
+		std::vector<uint32_t> m_dfnum;
+		std::vector<uint32_t> m_parent;
+		std::vector<uint32_t> m_semi; // DFS number of the semi-dominator
+		std::vector<uint32_t> m_ancestor;
+		std::vector<uint32_t> m_best;
+		std::vector<uint32_t> m_sameDom;
+		std::vector<uint32_t> m_bucketHead;
+		std::vector<uint32_t> m_bucketNext;
+		// Indexed by DFS number
+		std::vector<uint32_t> m_vertex;
+		std::vector<uint32_t> m_path;
+	};
+}
+
+void DominatorTree::Search()
+{
+	struct Frame {
+		uint32_t node;
+		uint32_t nextSuccessor;
+	};
+	std::vector<Frame> stack;
+	m_dfnum[m_root] = 0;
+	m_vertex.push_back(m_root);
+	stack.push_back({m_root, 0});
+	while(!stack.empty()) {
+		auto &frame = stack.back();
+		auto successors = m_successors.Get(frame.node);
+		if(frame.nextSuccessor >= successors.size()) {
+			stack.pop_back();
+			continue;
+		}
+		auto w = successors[frame.nextSuccessor++];
+		if(m_dfnum[w] != NONE)
+			continue;
+		m_dfnum[w] = static_cast<uint32_t>(m_vertex.size());
+		m_vertex.push_back(w);
+		m_parent[w] = frame.node;
+		stack.push_back({w, 0});
+	}
+}
+
+uint32_t DominatorTree::Eval(uint32_t v)
+{
+	// Collect the nodes whose ancestor links have to be compressed, then compress them from the top down
+	auto u = v;
+	while(m_ancestor[u] != NONE && m_ancestor[m_ancestor[u]] != NONE) {
+		m_path.push_back(u);
+		u = m_ancestor[u];
+	}
+	while(!m_path.empty()) {
+		auto w = m_path.back();
+		m_path.pop_back();
+		auto a = m_ancestor[w];
+		if(m_semi[m_best[a]] < m_semi[m_best[w]])
+			m_best[w] = m_best[a];
+		m_ancestor[w] = m_ancestor[a];
+	}
+	return m_best[v];
+}
+
+void DominatorTree::Compute(std::vector<uint32_t> &outIdom, std::vector<uint32_t> &outOrder)
+{
+	auto numNodes = m_successors.offsets.size() - 1;
+	m_dfnum.assign(numNodes, NONE);
+	m_parent.assign(numNodes, NONE);
+	m_semi.assign(numNodes, NONE);
+	m_ancestor.assign(numNodes, NONE);
+	m_best.resize(numNodes);
+	m_sameDom.assign(numNodes, NONE);
+	m_bucketHead.assign(numNodes, NONE);
+	m_bucketNext.assign(numNodes, NONE);
+	outIdom.assign(numNodes, NONE);
+	m_vertex.reserve(numNodes);
+	Search();
+
+	for(uint32_t i = 0; i < m_vertex.size(); ++i) {
+		auto v = m_vertex[i];
+		m_semi[v] = i;
+		m_best[v] = v;
+	}
+	for(auto i = m_vertex.size() - 1; i > 0; --i) {
+		auto n = m_vertex[i];
+		auto p = m_parent[n];
+		auto s = m_dfnum[p];
+		for(auto v : m_predecessors.Get(n)) {
+			if(m_dfnum[v] == NONE)
+				continue;
+			auto sPrime = (m_dfnum[v] <= m_dfnum[n]) ? m_dfnum[v] : m_semi[Eval(v)];
+			s = std::min(s, sPrime);
+		}
+		m_semi[n] = s;
+		auto semiNode = m_vertex[s];
+		m_bucketNext[n] = m_bucketHead[semiNode];
+		m_bucketHead[semiNode] = n;
+		// Link
+		m_ancestor[n] = p;
+
+		for(auto v = m_bucketHead[p]; v != NONE; v = m_bucketNext[v]) {
+			auto y = Eval(v);
+			if(m_semi[y] == m_semi[v])
+				outIdom[v] = p;
+			else
+				m_sameDom[v] = y;
+		}
+		m_bucketHead[p] = NONE;
+	}
+	for(uint32_t i = 1; i < m_vertex.size(); ++i) {
+		auto n = m_vertex[i];
+		if(m_sameDom[n] != NONE)
+			outIdom[n] = outIdom[m_sameDom[n]];
+	}
+	outOrder = std::move(m_vertex);
+}
+
+static Adjacency build_adjacency(uint32_t numNodes, const std::vector<lua::HeapSnapshot::Edge> &edges, bool reverse, uint32_t root)
+{
+	Adjacency adjacency {};
+	adjacency.offsets.assign(numNodes + 1, 0);
+	auto getNodes = [reverse, root](const lua::HeapSnapshot::Edge &e) {
+		auto parent = (e.parent == lua::HeapSnapshot::INVALID_INDEX) ? root : e.parent;
+		return reverse ? std::pair {e.child, parent} : std::pair {parent, e.child};
+	};
+	for(auto &e : edges)
+		++adjacency.offsets[getNodes(e).first + 1];
+	for(uint32_t i = 0; i < numNodes; ++i)
+		adjacency.offsets[i + 1] += adjacency.offsets[i];
+	adjacency.nodes.resize(edges.size());
+	auto cursor = adjacency.offsets;
+	for(auto &e : edges) {
+		auto [from, to] = getNodes(e);
+		adjacency.nodes[cursor[from]++] = to;
+	}
+	return adjacency;
+}
+
+void lua::HeapSnapshot::ComputeRetainedSizes()
+{
+	// The root (registry) is represented by an additional virtual node
+	auto numObjects = static_cast<uint32_t>(objects.size());
+	auto root = numObjects;
+	std::vector<uint32_t> idom;
+	std::vector<uint32_t> order;
+	{
+		auto successors = build_adjacency(numObjects + 1, edges, false, root);
+		auto predecessors = build_adjacency(numObjects + 1, edges, true, root);
+		DominatorTree tree {successors, predecessors, root};
+		tree.Compute(idom, order);
+	}
+
+	retainedSizes.assign(numObjects, 0);
+	for(uint32_t i = 0; i < numObjects; ++i)
+		retainedSizes[i] = objects[i].size;
+	// Every object is visited after its dominator in DFS order, so the sizes can be accumulated in reverse order
+	for(auto it = order.rbegin(); it != order.rend(); ++it) {
+		auto v = *it;
+		if(v == root)
+			continue;
+		auto d = idom[v];
+		if(d != DominatorTree::NONE && d != root)
+			retainedSizes[d] += retainedSizes[v];
+	}
+	immediateDominators.resize(numObjects);
+	for(uint32_t i = 0; i < numObjects; ++i)
+		immediateDominators[i] = (idom[i] == root) ? INVALID_INDEX : idom[i];
+}
+
+bool lua::HeapSnapshot::HasRetainedSizes() const { return !objects.empty() && retainedSizes.size() == objects.size() && immediateDominators.size() == objects.size(); }
+
+std::vector<lua::HeapSnapshot::Retainer> lua::HeapSnapshot::GetTopRetainers(uint32_t count) const
+{
+	if(!HasRetainedSizes())
+		return {};
+	std::vector<Retainer> retainers;
+	retainers.reserve(objects.size());
+	for(uint32_t i = 0; i < objects.size(); ++i)
+		retainers.push_back({i, retainedSizes[i]});
+	count = std::min<uint32_t>(count, static_cast<uint32_t>(retainers.size()));
+	std::partial_sort(retainers.begin(), retainers.begin() + count, retainers.end(), [](const Retainer &a, const Retainer &b) { return a.retainedSize > b.retainedSize; });
+	retainers.resize(count);
+	return retainers;
+}
+
+std::string lua::HeapSnapshot::FormatTopRetainers(uint32_t count) const
+{
+	std::string report = "retained\tshallow\ttype\tpath\n";
+	for(auto &retainer : GetTopRetainers(count)) {
+		auto &o = objects[retainer.objectIndex];
+		report += std::to_string(retainer.retainedSize) + '\t' + std::to_string(o.size) + '\t' + get_object_type_name(o.type) + '\t' + GetPath(retainer.objectIndex) + '\n';
+	}
+	return report;
+}
+
+namespace {
+	constexpr std::array<char, 4> SNAPSHOT_IDENTIFIER = {'L', 'S', 'N', 'P'};
+	// Version 1 stored objects and edges row by row, version 2 stores them column by column
+	constexpr uint32_t SNAPSHOT_VERSION = 2;
+	enum class SnapshotFlags : uint32_t {
+		None = 0,
+		RetainedSizes = 1,
+	};
+}
+
+// Columns are copied in blocks to avoid a copy of the entire column. The blocks are kept small enough to live on the stack.
+template<typename T>
+static constexpr size_t COLUMN_BLOCK_SIZE = 4'096 / sizeof(T);
+
+template<typename T, typename TObject, typename TMember>
+static bool write_column(VFilePtrReal &f, const std::vector<TObject> &objects, TMember TObject::*member)
+{
+	constexpr auto BLOCK_SIZE = COLUMN_BLOCK_SIZE<T>;
+	std::array<T, BLOCK_SIZE> block;
+	for(size_t i = 0; i < objects.size(); i += BLOCK_SIZE) {
+		auto n = std::min(BLOCK_SIZE, objects.size() - i);
+		for(size_t j = 0; j < n; ++j)
+			block[j] = static_cast<T>(objects[i + j].*member);
+		if(f->Write(block.data(), n * sizeof(T)) != n * sizeof(T))
+			return false;
+	}
+	return true;
+}
+
+template<typename T, typename TObject, typename TMember>
+static void read_column(VFilePtr &f, std::vector<TObject> &objects, TMember TObject::*member)
+{
+	constexpr auto BLOCK_SIZE = COLUMN_BLOCK_SIZE<T>;
+	std::array<T, BLOCK_SIZE> block;
+	for(size_t i = 0; i < objects.size(); i += BLOCK_SIZE) {
+		auto n = std::min(BLOCK_SIZE, objects.size() - i);
+		f->Read(block.data(), n * sizeof(T));
+		for(size_t j = 0; j < n; ++j)
+			objects[i + j].*member = static_cast<TMember>(block[j]);
+	}
+}
+
+bool lua::HeapSnapshot::Save(const std::string &path) const
+{
+	auto f = FileManager::OpenFile<VFilePtrReal>(path.c_str(), "wb");
+	if(f == nullptr)
+		return false;
+	auto hasRetainedSizes = HasRetainedSizes();
+	auto write = [&f](const void *data, size_t size) { return f->Write(data, size) == size; };
+	auto writeUInt32 = [&write](uint32_t value) { return write(&value, sizeof(value)); };
+	auto success = write(SNAPSHOT_IDENTIFIER.data(), SNAPSHOT_IDENTIFIER.size()) && writeUInt32(SNAPSHOT_VERSION)
+	  && writeUInt32(static_cast<uint32_t>(hasRetainedSizes ? SnapshotFlags::RetainedSizes : SnapshotFlags::None)) && writeUInt32(static_cast<uint32_t>(objects.size()))
+	  && writeUInt32(static_cast<uint32_t>(edges.size())) && writeUInt32(static_cast<uint32_t>(descriptions.size()));
+	success = success && write_column<uint64_t>(f, objects, &Object::address) && write_column<uint32_t>(f, objects, &Object::size) && write_column<uint32_t>(f, objects, &Object::parentEdge)
+	  && write_column<uint8_t>(f, objects, &Object::type) && write_column<uint32_t>(f, edges, &Edge::parent) && write_column<uint32_t>(f, edges, &Edge::child)
+	  && write_column<uint32_t>(f, edges, &Edge::description);
+	for(auto it = descriptions.begin(); success && it != descriptions.end(); ++it)
+		success = writeUInt32(static_cast<uint32_t>(it->size())) && write(it->data(), it->size());
+	if(success && hasRetainedSizes)
+		success = write(immediateDominators.data(), immediateDominators.size() * sizeof(immediateDominators.front())) && write(retainedSizes.data(), retainedSizes.size() * sizeof(retainedSizes.front()));
+	if(!success) {
+		// A truncated snapshot would only be rejected when it is loaded
+		std::filesystem::path filePath = f->GetPath();
+		f = nullptr;
+		std::error_code ec;
+		std::filesystem::remove(filePath, ec);
+		return false;
+	}
+	return true;
+}
+
+std::optional<lua::HeapSnapshot> lua::HeapSnapshot::Load(const std::string &path)
+{
+	auto f = FileManager::OpenFile(path.c_str(), "rb");
+	if(f == nullptr)
+		return {};
+	std::array<char, 4> identifier;
+	f->Read(identifier.data(), identifier.size());
+	if(identifier != SNAPSHOT_IDENTIFIER)
+		return {};
+	auto version = f->Read<uint32_t>();
+	if(version < 1 || version > SNAPSHOT_VERSION)
+		return {};
+	auto flags = (version >= 2) ? f->Read<uint32_t>() : 0;
+	auto numObjects = f->Read<uint32_t>();
+	auto numEdges = f->Read<uint32_t>();
+	auto numDescriptions = f->Read<uint32_t>();
+	// The counts are validated against the size of the file before anything is allocated, so a corrupted
+	// or truncated file can't cause huge allocations
+	auto fileSize = f->GetSize();
+	auto getRemainingSize = [&f, fileSize]() -> uint64_t {
+		auto pos = f->Tell();
+		return (pos < fileSize) ? (fileSize - pos) : 0;
+	};
+	constexpr uint64_t OBJECT_SIZE = sizeof(uint64_t) + sizeof(uint32_t) * 2 + sizeof(uint8_t);
+	constexpr uint64_t EDGE_SIZE = sizeof(uint32_t) * 3;
+	if(static_cast<uint64_t>(numObjects) * OBJECT_SIZE + static_cast<uint64_t>(numEdges) * EDGE_SIZE + static_cast<uint64_t>(numDescriptions) * sizeof(uint32_t) > getRemainingSize())
+		return {};
+	HeapSnapshot snapshot {};
+	snapshot.objects.resize(numObjects);
+	snapshot.edges.resize(numEdges);
+	snapshot.descriptions.resize(numDescriptions);
+	if(version == 1) {
+		for(auto &o : snapshot.objects) {
+			o.address = f->Read<uint64_t>();
+			o.size = f->Read<uint32_t>();
+			o.parentEdge = f->Read<uint32_t>();
+			o.type = static_cast<ObjectType>(f->Read<uint8_t>());
+		}
+		for(auto &e : snapshot.edges) {
+			e.parent = f->Read<uint32_t>();
+			e.child = f->Read<uint32_t>();
+			e.description = f->Read<uint32_t>();
+		}
+	}
+	else {
+		read_column<uint64_t>(f, snapshot.objects, &Object::address);
+		read_column<uint32_t>(f, snapshot.objects, &Object::size);
+		read_column<uint32_t>(f, snapshot.objects, &Object::parentEdge);
+		read_column<uint8_t>(f, snapshot.objects, &Object::type);
+		read_column<uint32_t>(f, snapshot.edges, &Edge::parent);
+		read_column<uint32_t>(f, snapshot.edges, &Edge::child);
+		read_column<uint32_t>(f, snapshot.edges, &Edge::description);
+	}
+	for(auto &desc : snapshot.descriptions) {
+		auto len = f->Read<uint32_t>();
+		if(len > getRemainingSize())
+			return {};
+		desc.resize(len);
+		f->Read(desc.data(), desc.size());
+	}
+	if(flags & static_cast<uint32_t>(SnapshotFlags::RetainedSizes)) {
+		if(static_cast<uint64_t>(numObjects) * (sizeof(uint32_t) + sizeof(uint64_t)) > getRemainingSize())
+			return {};
+		snapshot.immediateDominators.resize(snapshot.objects.size());
+		snapshot.retainedSizes.resize(snapshot.objects.size());
+		f->Read(snapshot.immediateDominators.data(), snapshot.immediateDominators.size() * sizeof(snapshot.immediateDominators.front()));
+		f->Read(snapshot.retainedSizes.data(), snapshot.retainedSizes.size() * sizeof(snapshot.retainedSizes.front()));
+	}
+	// Reject corrupted or truncated files
+	for(auto &e : snapshot.edges) {
+		if((e.parent != INVALID_INDEX && e.parent >= numObjects) || e.child >= numObjects || e.description >= snapshot.descriptions.size())
+			return {};
+	}
+	for(auto &o : snapshot.objects) {
+		if(o.parentEdge != INVALID_INDEX && o.parentEdge >= snapshot.edges.size())
+			return {};
+	}
+	// An object retains at least its own size and at most everything in the snapshot
+	auto totalSize = snapshot.GetTotalSize();
+	for(uint32_t i = 0; i < snapshot.immediateDominators.size(); ++i) {
+		auto idom = snapshot.immediateDominators[i];
+		if(idom != INVALID_INDEX && (idom >= numObjects || idom == i))
+			return {};
+		auto retainedSize = snapshot.retainedSizes[i];
+		if(retainedSize < snapshot.objects[i].size || retainedSize > totalSize)
+			return {};
+	}
+	return snapshot;
+}
+
+std::vector<uint32_t> lua::diff_snapshots(const HeapSnapshot &older, const HeapSnapshot &newer)
+{
+	auto getKey = [](const HeapSnapshot::Object &o) { return o.address ^ (static_cast<uint64_t>(o.type) << 56); };
+	std::unordered_set<uint64_t> oldObjects;
+	oldObjects.reserve(older.objects.size());
+	for(auto &o : older.objects)
+		oldObjects.insert(getKey(o));
+	std::vector<uint32_t> created;
+	for(uint32_t i = 0; i < newer.objects.size(); ++i) {
+		if(!oldObjects.contains(getKey(newer.objects[i])))
+			created.push_back(i);
+	}
+	return created;
+}
+
+const char *lua::get_object_type_name(HeapSnapshot::ObjectType type)
+{
+	switch(type) {
+	case HeapSnapshot::ObjectType::Table:
+		return "table";
+	case HeapSnapshot::ObjectType::Function:
+		return "function";
+	case HeapSnapshot::ObjectType::Thread:
+		return "thread";
+	case HeapSnapshot::ObjectType::UserData:
+		return "userdata";
+	case HeapSnapshot::ObjectType::String:
+		return "string";
+	}
+	return "unknown";
+}
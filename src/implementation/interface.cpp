@@ -17,39 +17,279 @@ static std::string get_normalized_path(const std::string_view &path)
 	return normPath;
 }
 
+namespace {
+	// Iterates the characters of a path in normalized form (lower-case, forward slashes,
+	// no leading, trailing or duplicate slashes and no "." segments) without copying it.
+	class NormalizedPathReader {
+	  public:
+		NormalizedPathReader(const std::string_view &path) : m_path {path} { NextSegment(); }
+		// Returns '\0' once the end of the path has been reached
+		char Next()
+		{
+			if(m_pos == m_segmentEnd) {
+				if(!NextSegment())
+					return '\0';
+				return '/';
+			}
+			return static_cast<char>(std::tolower(static_cast<unsigned char>(m_path[m_pos++])));
+		}
+	  private:
+		static bool IsSeparator(char c) { return c == '/' || c == '\\'; }
+		bool NextSegment()
+		{
+			for(;;) {
+				while(m_segmentEnd < m_path.size() && IsSeparator(m_path[m_segmentEnd]))
+					++m_segmentEnd;
+				if(m_segmentEnd >= m_path.size()) {
+					m_pos = m_segmentEnd;
+					return false;
+				}
+				m_pos = m_segmentEnd;
+				while(m_segmentEnd < m_path.size() && !IsSeparator(m_path[m_segmentEnd]))
+					++m_segmentEnd;
+				if(m_segmentEnd - m_pos == 1 && m_path[m_pos] == '.')
+					continue;
+				return true;
+			}
+		}
+		std::string_view m_path;
+		size_t m_pos = 0;
+		size_t m_segmentEnd = 0;
+	};
+}
+
+static bool has_parent_reference(const std::string_view &path) { return path.find("..") != std::string_view::npos; }
+
+template<typename TFunc>
+static auto with_resolved_path(const std::string_view &path, const TFunc &func)
+{
+	// Parent directory references can't be resolved in place
+	if(has_parent_reference(path))
+		return func(std::string_view {get_normalized_path(path)});
+	return func(path);
+}
+
+static std::string to_normalized_key(const std::string_view &path)
+{
+	return with_resolved_path(path, [](const std::string_view &resolvedPath) {
+		std::string key;
+		key.reserve(resolvedPath.size());
+		NormalizedPathReader reader {resolvedPath};
+		for(auto c = reader.Next(); c != '\0'; c = reader.Next())
+			key += c;
+		return key;
+	});
+}
+
+size_t Lua::IncludeCache::PathHash::operator()(const std::string_view &path) const
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	NormalizedPathReader reader {path};
+	for(auto c = reader.Next(); c != '\0'; c = reader.Next()) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+bool Lua::IncludeCache::PathEqual::operator()(const std::string_view &a, const std::string_view &b) const
+{
+	NormalizedPathReader readerA {a};
+	NormalizedPathReader readerB {b};
+	for(;;) {
+		auto ca = readerA.Next();
+		if(ca != readerB.Next())
+			return false;
+		if(ca == '\0')
+			return true;
+	}
+}
+
+template<typename TFunc>
+auto Lua::IncludeCache::Find(const std::string_view &path, const TFunc &func) const
+{
+	return with_resolved_path(path, [this, &func](const std::string_view &resolvedPath) {
+		auto it = m_cache.find(resolvedPath);
+		return func((it != m_cache.end()) ? &it->second : nullptr);
+	});
+}
+
 bool Lua::IncludeCache::Contains(const std::string_view &path) const
 {
-	// TODO: It would be more efficient to generate a path-hash directly instead of copying the string
-	auto hash = ustring::string_switch_ci::hash(get_normalized_path(path));
-	return m_cache.contains(hash);
+	return Find(path, [](const Entry *entry) { return entry != nullptr; });
 }
 void Lua::IncludeCache::Add(const std::string_view &path)
 {
-	auto hash = ustring::string_switch_ci::hash(get_normalized_path(path));
-	m_cache.insert(hash);
+	if(Contains(path))
+		return;
+	m_cache.insert(std::make_pair(to_normalized_key(path), Entry {}));
+}
+// All threads of a lua state share the same registry
+static const void *get_registry(lua_State *l)
+{
+	lua_pushvalue(l, LUA_REGISTRYINDEX);
+	auto *registry = lua_topointer(l, -1);
+	lua_pop(l, 1);
+	return registry;
+}
+
+// References are released through a thread that is anchored in the registry, since the thread
+// that added an entry may be a coroutine which has been collected in the meantime.
+static char g_includeCacheThreadKey = 0;
+static lua_State *get_reference_thread(lua_State *l)
+{
+	lua_pushlightuserdata(l, &g_includeCacheThreadKey);
+	lua_rawget(l, LUA_REGISTRYINDEX);
+	auto *thread = lua_tothread(l, -1);
+	lua_pop(l, 1);
+	if(thread)
+		return thread;
+	lua_pushlightuserdata(l, &g_includeCacheThreadKey);
+	thread = lua_newthread(l);
+	lua_rawset(l, LUA_REGISTRYINDEX);
+	return thread;
+}
+void Lua::IncludeCache::Add(lua_State *l, const std::string_view &path, int32_t idx)
+{
+	lua_pushvalue(l, idx);
+	auto ref = luaL_ref(l, LUA_REGISTRYINDEX);
+	auto key = to_normalized_key(path);
+	auto it = m_cache.find(std::string_view {key});
+	if(it == m_cache.end())
+		it = m_cache.insert(std::make_pair(std::move(key), Entry {})).first;
+	// Only references of the same state are replaced, other states may have been closed already
+	auto *registry = get_registry(l);
+	auto &refs = it->second.references;
+	auto itRef = std::find_if(refs.begin(), refs.end(), [registry](const Reference &r) { return r.registry == registry; });
+	if(itRef == refs.end()) {
+		refs.push_back({LUA_NOREF, get_reference_thread(l), registry});
+		itRef = refs.end() - 1;
+	}
+	else if(itRef->reference != LUA_NOREF)
+		luaL_unref(itRef->state, LUA_REGISTRYINDEX, itRef->reference);
+	itRef->reference = ref;
+}
+bool Lua::IncludeCache::PushValue(lua_State *l, const std::string_view &path) const
+{
+	auto *entry = Find(path, [](const Entry *e) { return e; });
+	if(entry == nullptr)
+		return false;
+	auto *registry = get_registry(l);
+	for(auto &ref : entry->references) {
+		if(ref.registry != registry || ref.reference == LUA_NOREF)
+			continue;
+		lua_rawgeti(l, LUA_REGISTRYINDEX, ref.reference);
+		return true;
+	}
+	return false;
+}
+void Lua::IncludeCache::Clear(lua_State *l)
+{
+	auto *registry = get_registry(l);
+	std::erase_if(m_cache, [l, registry](std::pair<const std::string, Entry> &pair) {
+		auto &refs = pair.second.references;
+		auto n = std::erase_if(refs, [l, registry](const Reference &ref) {
+			if(ref.registry != registry)
+				return false;
+			if(ref.reference != LUA_NOREF)
+				luaL_unref(l, LUA_REGISTRYINDEX, ref.reference);
+			return true;
+		});
+		// Paths that were only added by this state are removed as well, paths without values (see Add(path)) are kept
+		return n > 0 && refs.empty();
+	});
 }
 void Lua::IncludeCache::Clear() { m_cache.clear(); }
 
+Lua::StatusCode Lua::IncludeFile(lua_State *lua, IncludeCache &cache, std::string &fInOut, std::string &outErr, bool cacheResult, int32_t (*traceback)(lua_State *), void (*loadErrorHandler)(lua_State *, StatusCode))
+{
+	fInOut = GetIncludePath(lua, fInOut);
+	if(cacheResult) {
+		if(cache.PushValue(lua, fInOut))
+			return StatusCode::Ok;
+	}
+	else if(cache.Contains(fInOut))
+		return StatusCode::Ok;
+	auto path = fInOut;
+	auto r = ExecuteFile(lua, fInOut, outErr, traceback, cacheResult ? 1 : 0, loadErrorHandler);
+	if(r != StatusCode::Ok)
+		return r;
+	if(cacheResult)
+		cache.Add(lua, path, -1);
+	else
+		cache.Add(path);
+	return r;
+}
+
 Lua::Interface::Interface() {}
 
 Lua::Interface::~Interface()
 {
+	if(m_profiler)
+		m_profiler->Stop();
+	// The scheduler releases its thread references, so it has to be destroyed before the state
+	m_coroutineScheduler = nullptr;
+	m_bufferBridge = nullptr;
+	m_metrics = nullptr;
 	if(m_state != nullptr)
 		lua_close(m_state);
 }
 
-void Lua::Interface::Open()
+void Lua::Interface::Open(AllocatorType allocatorType)
 {
 	if(m_state != nullptr)
 		return;
+	if(allocatorType == AllocatorType::Pool) {
+		m_allocator = std::make_unique<PoolAllocator>();
+		m_state = lua::new_state(PoolAllocator::Allocate, m_allocator.get());
+		if(m_state == nullptr)
+			m_allocator = nullptr;
+	}
+	if(m_state == nullptr) {
 #ifdef USE_LUAJIT
-	m_state = lua_open();
+		m_state = lua_open();
 #else
-	m_state = luaL_newstate();
+		m_state = luaL_newstate();
 #endif
+	}
+	if constexpr(METRICS_ENABLED)
+		m_metrics = std::make_unique<Metrics>(m_state);
 }
 
+Lua::Metrics *Lua::Interface::GetMetrics() { return m_metrics.get(); }
+
+const Lua::PoolAllocator *Lua::Interface::GetAllocator() const { return m_allocator.get(); }
+
 Lua::IncludeCache &Lua::Interface::GetIncludeCache() { return m_luaIncludeCache; }
+Lua::Profiler &Lua::Interface::GetProfiler()
+{
+	if(!m_profiler)
+		m_profiler = std::make_unique<Profiler>();
+	return *m_profiler;
+}
+
+Lua::CoroutineScheduler &Lua::Interface::GetCoroutineScheduler()
+{
+	if(!m_coroutineScheduler)
+		m_coroutineScheduler = std::make_unique<CoroutineScheduler>(m_state);
+	return *m_coroutineScheduler;
+}
+
+Lua::GarbageCollector &Lua::Interface::GetGarbageCollector()
+{
+	if(!m_garbageCollector)
+		m_garbageCollector = std::make_unique<GarbageCollector>(m_state);
+	return *m_garbageCollector;
+}
+bool Lua::Interface::StepGarbageCollector(std::chrono::microseconds budget) { return GetGarbageCollector().Step(budget); }
+
+Lua::BufferBridge &Lua::Interface::GetBufferBridge()
+{
+	if(!m_bufferBridge)
+		m_bufferBridge = std::make_unique<BufferBridge>(m_state);
+	return *m_bufferBridge;
+}
 
 void Lua::Interface::SetIdentifier(const std::string &identifier) { m_identifier = identifier; }
 const std::string &Lua::Interface::GetIdentifier() const { return m_identifier; }
@@ -74,27 +314,152 @@ luabind::module_ &Lua::Interface::RegisterLibrary(const char *name, const std::u
 		if(bExists) {
 			// If the library already exists, just add the new functions to it
 			auto t = Lua::GetStackTop(m_state);
+			// Tables with a metatable (e.g. luabind namespaces or proxies) may rely on __newindex
+			auto raw = is_plain_table(m_state, t);
+			luaL_checkstack(m_state, 2, nullptr);
 			for(auto &pair : functions) {
-				Lua::PushString(m_state, pair.first);
-				Lua::PushCFunction(m_state, pair.second);
-				Lua::SetTableValue(m_state, t);
+				lua_pushlstring(m_state, pair.first.data(), pair.first.size());
+				lua_pushcfunction(m_state, pair.second);
+				if(raw)
+					lua_rawset(m_state, t);
+				else
+					lua_settable(m_state, t);
 			}
 			Lua::Pop(m_state, 1);
 		}
 		else {
 			Lua::Pop(m_state, 1);
-			// Library doesn't exist yet; Create it
-			std::vector<luaL_Reg> regFuncs;
-			regFuncs.reserve(functions.size() + 1);
-			for(auto &pair : functions)
-				regFuncs.push_back({pair.first.c_str(), pair.second});
-			regFuncs.push_back({nullptr, nullptr});
-#pragma warning(disable : 4309)
-			lua_newtable(m_state);
-			luaL_setfuncs(m_state, regFuncs.data(), 0);
-#pragma warning(default : 4309)
+			// Library doesn't exist yet; Create it with enough space for all functions
+			lua_createtable(m_state, 0, static_cast<int>(functions.size()));
+			luaL_checkstack(m_state, 2, nullptr);
+			for(auto &pair : functions) {
+				lua_pushlstring(m_state, pair.first.data(), pair.first.size());
+				lua_pushcfunction(m_state, pair.second);
+				lua_rawset(m_state, -3);
+			}
 			lua_setglobal(m_state, name);
+			invalidate_global_path_handles(m_state);
 		}
 	}
 	return *mod;
 }
+
+static int32_t lazy_library_index(lua_State *l)
+{
+	// Upvalue 1: Interface, upvalue 2: Previous __index of the globals table (or nil)
+	if(lua_type(l, 2) == LUA_TSTRING) {
+		auto *lua = static_cast<Lua::Interface *>(lua_touserdata(l, lua_upvalueindex(1)));
+		size_t len;
+		auto *name = lua_tolstring(l, 2, &len);
+		// C++ exceptions must not unwind through the lua frames that invoked the metamethod
+		auto materialized = false;
+		auto failed = false;
+		try {
+			materialized = lua->MaterializeLibrary({name, len});
+		}
+		catch(const std::exception &e) {
+			lua_pushfstring(l, "failed to populate library '%s': %s", name, e.what());
+			failed = true;
+		}
+		catch(...) {
+			lua_pushfstring(l, "failed to populate library '%s'", name);
+			failed = true;
+		}
+		// Raised outside of the handler, after the exception has been destroyed
+		if(failed)
+			return lua_error(l);
+		if(materialized) {
+			lua_pushvalue(l, 2);
+			lua_rawget(l, 1);
+			if(!lua_isnil(l, -1))
+				return 1;
+			lua_pop(l, 1);
+		}
+	}
+	lua_pushvalue(l, lua_upvalueindex(2));
+	if(lua_isfunction(l, -1)) {
+		lua_pushvalue(l, 1);
+		lua_pushvalue(l, 2);
+		lua_call(l, 2, 1);
+	}
+	else if(lua_istable(l, -1)) {
+		lua_pushvalue(l, 2);
+		lua_gettable(l, -2);
+	}
+	else
+		lua_pushnil(l);
+	return 1;
+}
+
+void Lua::Interface::InstallLazyLibraryHandler()
+{
+	if(m_lazyLibraryHandlerInstalled)
+		return;
+	m_lazyLibraryHandlerInstalled = true;
+	luaL_checkstack(m_state, 4, nullptr);
+	lua_pushvalue(m_state, LUA_GLOBALSINDEX);
+	if(!lua_getmetatable(m_state, -1)) {
+		lua_newtable(m_state);
+		lua_pushvalue(m_state, -1);
+		lua_setmetatable(m_state, -3);
+	}
+	lua_pushlightuserdata(m_state, this);
+	lua_getfield(m_state, -2, "__index");
+	lua_pushcclosure(m_state, lazy_library_index, 2);
+	lua_setfield(m_state, -2, "__index");
+	lua_pop(m_state, 2);
+}
+
+void Lua::Interface::RegisterLazyLibrary(const std::string &name, const PopulateLibraryCallback &populate)
+{
+	auto it = m_lazyLibraries.find(name);
+	if(it != m_lazyLibraries.end()) {
+		if(it->second.materialized) {
+			// Too late to defer it
+			populate(*this, it->first.c_str());
+			return;
+		}
+		it->second.populate = populate;
+		return;
+	}
+	m_lazyLibraries.insert(std::make_pair(name, LazyLibrary {populate}));
+	InstallLazyLibraryHandler();
+}
+
+bool Lua::Interface::MaterializeLibrary(const std::string_view &name)
+{
+	auto it = m_lazyLibraries.find(name);
+	if(it == m_lazyLibraries.end())
+		return false;
+	auto &lib = it->second;
+	// Accesses to the library from within the callback must not populate it again
+	if(lib.materialized || lib.populating)
+		return true;
+	if(lib.populate) {
+		auto populate = std::move(lib.populate);
+		lib.populate = nullptr;
+		lib.populating = true;
+		try {
+			populate(*this, it->first.c_str());
+		}
+		catch(...) {
+			// The library is populated again on the next access
+			lib.populating = false;
+			lib.populate = std::move(populate);
+			throw;
+		}
+		lib.populating = false;
+	}
+	lib.materialized = true;
+	m_materializedLibraries.push_back(it->first);
+	invalidate_global_path_handles(m_state);
+	return true;
+}
+
+bool Lua::Interface::IsLibraryMaterialized(const std::string_view &name) const
+{
+	auto it = m_lazyLibraries.find(name);
+	return it != m_lazyLibraries.end() && it->second.materialized;
+}
+
+const std::vector<std::string> &Lua::Interface::GetMaterializedLibraries() const { return m_materializedLibraries; }
@@ -0,0 +1,210 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :metrics;
+
+static char g_metricsKey = 0;
+
+static uint64_t get_chunk_hash(const std::string_view &name)
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	for(auto c : name) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+Lua::Metrics::Metrics(lua_State *l) : m_state {l}, m_chunks {std::make_unique<std::atomic<Chunk *>[]>(MAX_CHUNK_COUNT)}, m_overflowChunk {0, OVERFLOW_CHUNK_NAME}
+{
+	lua_pushlightuserdata(l, &g_metricsKey);
+	lua_pushlightuserdata(l, this);
+	lua_rawset(l, LUA_REGISTRYINDEX);
+}
+
+Lua::Metrics::~Metrics()
+{
+	lua_pushlightuserdata(m_state, &g_metricsKey);
+	lua_pushnil(m_state);
+	lua_rawset(m_state, LUA_REGISTRYINDEX);
+	for(uint32_t i = 0; i < MAX_CHUNK_COUNT; ++i)
+		delete m_chunks[i].load();
+}
+
+Lua::Metrics *Lua::Metrics::Get(lua_State *l)
+{
+	lua_pushlightuserdata(l, &g_metricsKey);
+	lua_rawget(l, LUA_REGISTRYINDEX);
+	auto *metrics = static_cast<Metrics *>(lua_touserdata(l, -1));
+	lua_pop(l, 1);
+	return metrics;
+}
+
+const char *Lua::Metrics::GetOperationName(Operation op)
+{
+	switch(op) {
+	case Operation::FileLookup:
+		return "file_lookup";
+	case Operation::FileRead:
+		return "file_read";
+	case Operation::Parse:
+		return "parse";
+	case Operation::ExecuteFile:
+		return "execute_file";
+	case Operation::ProtectedCall:
+		return "protected_call";
+	case Operation::RunString:
+		return "run_string";
+	}
+	return "unknown";
+}
+
+Lua::Metrics::Chunk &Lua::Metrics::GetChunk(const std::string_view &chunkName)
+{
+	auto hash = get_chunk_hash(chunkName);
+	auto idx = hash % MAX_CHUNK_COUNT;
+	// The probe length is updated before the count, so it is final once the table is full
+	auto full = m_chunkCount.load(std::memory_order_acquire) >= MAX_CHUNK_COUNT;
+	auto maxProbeLength = full ? m_maxProbeLength.load(std::memory_order_acquire) : MAX_CHUNK_COUNT;
+	for(uint32_t i = 0; i < MAX_CHUNK_COUNT && i <= maxProbeLength; ++i) {
+		auto &slot = m_chunks[idx];
+		auto *chunk = slot.load(std::memory_order_acquire);
+		if(chunk == nullptr) {
+			auto *newChunk = new Chunk {hash, chunkName};
+			if(slot.compare_exchange_strong(chunk, newChunk, std::memory_order_acq_rel)) {
+				auto probeLength = m_maxProbeLength.load(std::memory_order_relaxed);
+				while(i > probeLength && !m_maxProbeLength.compare_exchange_weak(probeLength, i, std::memory_order_acq_rel))
+					;
+				m_chunkCount.fetch_add(1, std::memory_order_acq_rel);
+				return *newChunk;
+			}
+			// Another thread has claimed the slot first, 'chunk' now contains its entry
+			delete newChunk;
+		}
+		if(chunk->hash == hash && chunk->name == chunkName)
+			return *chunk;
+		idx = (idx + 1) % MAX_CHUNK_COUNT;
+	}
+	return m_overflowChunk;
+}
+
+void Lua::Metrics::Record(Operation op, const std::string_view &chunkName, std::chrono::nanoseconds duration, bool success)
+{
+	auto &counters = GetChunk(chunkName).operations[static_cast<size_t>(op)];
+	auto ns = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+	counters.calls.fetch_add(1, std::memory_order_relaxed);
+	if(!success)
+		counters.failures.fetch_add(1, std::memory_order_relaxed);
+	counters.totalTime.fetch_add(ns, std::memory_order_relaxed);
+	auto maxTime = counters.maxTime.load(std::memory_order_relaxed);
+	while(ns > maxTime && !counters.maxTime.compare_exchange_weak(maxTime, ns, std::memory_order_relaxed))
+		;
+	auto bucket = std::min<uint32_t>(std::bit_width(ns / 1'000), HISTOGRAM_BUCKET_COUNT - 1);
+	counters.histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<Lua::Metrics::ChunkStats> Lua::Metrics::GetSnapshot() const
+{
+	std::vector<ChunkStats> snapshot;
+	auto addChunk = [&snapshot](const Chunk &chunk) {
+		ChunkStats stats {};
+		auto hasCalls = false;
+		for(size_t i = 0; i < chunk.operations.size(); ++i) {
+			auto &counters = chunk.operations[i];
+			auto &opStats = stats.operations[i];
+			opStats.calls = counters.calls.load(std::memory_order_relaxed);
+			opStats.failures = counters.failures.load(std::memory_order_relaxed);
+			opStats.totalTime = std::chrono::nanoseconds {counters.totalTime.load(std::memory_order_relaxed)};
+			opStats.maxTime = std::chrono::nanoseconds {counters.maxTime.load(std::memory_order_relaxed)};
+			for(size_t j = 0; j < opStats.histogram.size(); ++j)
+				opStats.histogram[j] = counters.histogram[j].load(std::memory_order_relaxed);
+			hasCalls = hasCalls || opStats.calls > 0;
+		}
+		if(!hasCalls)
+			return;
+		stats.chunkName = chunk.name;
+		snapshot.push_back(std::move(stats));
+	};
+	for(uint32_t i = 0; i < MAX_CHUNK_COUNT; ++i) {
+		auto *chunk = m_chunks[i].load(std::memory_order_acquire);
+		if(chunk)
+			addChunk(*chunk);
+	}
+	addChunk(m_overflowChunk);
+	return snapshot;
+}
+
+void Lua::Metrics::Reset()
+{
+	// Chunks are kept, since other threads may be recording into them
+	auto resetChunk = [](Chunk &chunk) {
+		for(auto &counters : chunk.operations) {
+			counters.calls = 0;
+			counters.failures = 0;
+			counters.totalTime = 0;
+			counters.maxTime = 0;
+			for(auto &count : counters.histogram)
+				count = 0;
+		}
+	};
+	for(uint32_t i = 0; i < MAX_CHUNK_COUNT; ++i) {
+		auto *chunk = m_chunks[i].load(std::memory_order_acquire);
+		if(chunk)
+			resetChunk(*chunk);
+	}
+	resetChunk(m_overflowChunk);
+}
+
+void Lua::Metrics::PushSnapshot(lua_State *l) const
+{
+	auto snapshot = GetSnapshot();
+	// Snapshot, chunk name and table, operation name and table, histogram table and value
+	luaL_checkstack(l, 7, nullptr);
+	lua_createtable(l, 0, static_cast<int>(snapshot.size()));
+	for(auto &chunk : snapshot) {
+		lua_pushlstring(l, chunk.chunkName.data(), chunk.chunkName.size());
+		lua_createtable(l, 0, static_cast<int>(chunk.operations.size()));
+		for(size_t i = 0; i < chunk.operations.size(); ++i) {
+			auto &op = chunk.operations[i];
+			if(op.calls == 0)
+				continue;
+			lua_pushstring(l, GetOperationName(static_cast<Operation>(i)));
+			lua_createtable(l, 0, 5);
+
+			lua_pushnumber(l, static_cast<lua_Number>(op.calls));
+			lua_setfield(l, -2, "calls");
+			lua_pushnumber(l, static_cast<lua_Number>(op.failures));
+			lua_setfield(l, -2, "failures");
+			lua_pushnumber(l, std::chrono::duration<lua_Number>(op.totalTime).count());
+			lua_setfield(l, -2, "totalTime");
+			lua_pushnumber(l, std::chrono::duration<lua_Number>(op.maxTime).count());
+			lua_setfield(l, -2, "maxTime");
+
+			lua_createtable(l, static_cast<int>(op.histogram.size()), 0);
+			for(size_t j = 0; j < op.histogram.size(); ++j) {
+				lua_pushnumber(l, static_cast<lua_Number>(op.histogram[j]));
+				lua_rawseti(l, -2, static_cast<int>(j + 1));
+			}
+			lua_setfield(l, -2, "histogram");
+
+			lua_rawset(l, -3);
+		}
+		lua_rawset(l, -3);
+	}
+}
+
+int32_t Lua::Metrics::LuaGetSnapshot(lua_State *l)
+{
+	auto *metrics = Get(l);
+	if(metrics == nullptr)
+		return 0;
+	metrics->PushSnapshot(l);
+	return 1;
+}
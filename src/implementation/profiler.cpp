@@ -0,0 +1,205 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :profiler;
+
+static char g_profilerKey = 0;
+
+Lua::Profiler::Profiler(size_t sampleCapacity) { m_samples.resize(std::max<size_t>(sampleCapacity, 1)); }
+
+Lua::Profiler::~Profiler() { Stop(); }
+
+bool Lua::Profiler::Start(lua_State *l, std::chrono::microseconds interval, int32_t instructionCount)
+{
+	if(m_state != nullptr)
+		return false;
+	if(lua_gethook(l) != nullptr)
+		return false; // Another hook is already installed
+	m_state = l;
+	m_interval = interval;
+	m_nextSample = std::chrono::steady_clock::now() + m_interval;
+	lua_pushlightuserdata(l, &g_profilerKey);
+	lua_pushlightuserdata(l, this);
+	lua_rawset(l, LUA_REGISTRYINDEX);
+	lua_sethook(l, &Hook, LUA_MASKCOUNT, std::max(instructionCount, 1));
+	return true;
+}
+
+void Lua::Profiler::Stop()
+{
+	if(m_state == nullptr)
+		return;
+	lua_sethook(m_state, nullptr, 0, 0);
+	lua_pushlightuserdata(m_state, &g_profilerKey);
+	lua_pushnil(m_state);
+	lua_rawset(m_state, LUA_REGISTRYINDEX);
+	m_state = nullptr;
+	Flush();
+}
+
+bool Lua::Profiler::IsRunning() const { return m_state != nullptr; }
+
+void Lua::Profiler::Clear()
+{
+	m_sampleCount = 0;
+	m_totalSampleCount = 0;
+	m_droppedSampleCount = 0;
+	m_collapsedStacks.clear();
+	m_lineSamples.clear();
+}
+
+void Lua::Profiler::Update() { Flush(); }
+
+uint64_t Lua::Profiler::GetSampleCount() const { return m_totalSampleCount; }
+uint64_t Lua::Profiler::GetDroppedSampleCount() const { return m_droppedSampleCount; }
+
+void Lua::Profiler::Hook(lua_State *l, lua_Debug *)
+{
+	lua_pushlightuserdata(l, &g_profilerKey);
+	lua_rawget(l, LUA_REGISTRYINDEX);
+	auto *profiler = static_cast<Profiler *>(lua_touserdata(l, -1));
+	lua_pop(l, 1);
+	if(profiler == nullptr)
+		return;
+	auto t = std::chrono::steady_clock::now();
+	if(t < profiler->m_nextSample)
+		return;
+	profiler->m_nextSample = t + profiler->m_interval;
+	profiler->RecordSample(l);
+}
+
+uint32_t Lua::Profiler::GetSourceId(const std::string_view &source)
+{
+	auto it = m_sourceIds.find(source);
+	if(it != m_sourceIds.end())
+		return it->second;
+	auto id = static_cast<uint32_t>(m_sources.size());
+	m_sources.push_back(std::string {source});
+	m_sourceIds.insert(std::make_pair(std::string {source}, id));
+	return id;
+}
+
+// Number of levels on the call stack. lua_getstack has to walk the stack up to the requested level,
+// so the depth is found with an exponential and a binary search instead of probing every level.
+static int32_t get_stack_depth(lua_State *l)
+{
+	lua_Debug ar;
+	if(lua_getstack(l, 0, &ar) == 0)
+		return 0;
+	int32_t lower = 0; // Known to exist
+	int32_t upper = 1;
+	while(lua_getstack(l, upper, &ar) != 0) {
+		lower = upper;
+		upper *= 2;
+	}
+	// 'upper' is known not to exist
+	while(upper - lower > 1) {
+		auto mid = lower + (upper - lower) / 2;
+		if(lua_getstack(l, mid, &ar) != 0)
+			lower = mid;
+		else
+			upper = mid;
+	}
+	return upper;
+}
+
+void Lua::Profiler::RecordSample(lua_State *l)
+{
+	if(m_sampleCount == m_samples.size()) {
+		// Aggregating the samples allocates and takes too long to be done inside of the hook, it's left to Update
+		++m_droppedSampleCount;
+		return;
+	}
+	auto &sample = m_samples[m_sampleCount];
+	sample.depth = 0;
+	lua_Debug ar;
+	auto addFrames = [this, l, &sample, &ar](int32_t firstLevel, int32_t lastLevel, uint32_t maxDepth) {
+		for(auto level = firstLevel; level < lastLevel && sample.depth < maxDepth && lua_getstack(l, level, &ar); ++level) {
+			if(lua_getinfo(l, "Sl", &ar) == 0 || ar.currentline < 0)
+				continue; // C function
+			auto &frame = sample.frames[sample.depth++];
+			frame.source = GetSourceId(ar.source);
+			frame.line = ar.currentline;
+			frame.lineDefined = ar.linedefined;
+		}
+	};
+	auto numLevels = get_stack_depth(l);
+	if(numLevels <= static_cast<int32_t>(MAX_STACK_DEPTH))
+		addFrames(0, numLevels, MAX_STACK_DEPTH);
+	else {
+		// Keep both ends of the stack, the root frames are required to attribute the sample to the right
+		// call path and the innermost frames to the right function
+		constexpr auto NUM_ROOT_FRAMES = MAX_STACK_DEPTH / 2;
+		constexpr auto NUM_INNER_FRAMES = MAX_STACK_DEPTH - NUM_ROOT_FRAMES - 1;
+		addFrames(0, numLevels - static_cast<int32_t>(NUM_ROOT_FRAMES), NUM_INNER_FRAMES);
+		auto &marker = sample.frames[sample.depth++];
+		marker = {};
+		marker.source = TRUNCATED_SOURCE;
+		addFrames(numLevels - static_cast<int32_t>(NUM_ROOT_FRAMES), numLevels, MAX_STACK_DEPTH);
+	}
+	if(sample.depth == 0 || sample.frames[0].source == TRUNCATED_SOURCE)
+		return;
+	++m_sampleCount;
+	++m_totalSampleCount;
+}
+
+std::string Lua::Profiler::GetFrameName(const Frame &frame) const
+{
+	if(frame.source == TRUNCATED_SOURCE)
+		return "[truncated]";
+	std::string_view source = m_sources[frame.source];
+	if(!source.empty() && source.front() == '@')
+		source = source.substr(1);
+	return std::string {source} + ':' + std::to_string(frame.lineDefined);
+}
+
+void Lua::Profiler::Flush()
+{
+	std::string key;
+	for(size_t i = 0; i < m_sampleCount; ++i) {
+		auto &sample = m_samples[i];
+		key.clear();
+		// Stack levels start at the innermost frame, collapsed stacks start at the root
+		for(auto j = sample.depth; j > 0; --j) {
+			if(!key.empty())
+				key += ';';
+			key += GetFrameName(sample.frames[j - 1]);
+		}
+		++m_collapsedStacks[key];
+		auto &top = sample.frames[0];
+		++m_lineSamples[{top.source, top.line, top.lineDefined}];
+	}
+	m_sampleCount = 0;
+}
+
+std::vector<Lua::Profiler::LineStats> Lua::Profiler::GetLineStats()
+{
+	Flush();
+	std::vector<LineStats> stats;
+	stats.reserve(m_lineSamples.size());
+	for(auto &[key, count] : m_lineSamples) {
+		auto &[source, line, lineDefined] = key;
+		stats.push_back({m_sources[source], line, lineDefined, count});
+	}
+	std::sort(stats.begin(), stats.end(), [](const LineStats &a, const LineStats &b) { return a.samples > b.samples; });
+	return stats;
+}
+
+std::string Lua::Profiler::ExportCollapsedStacks()
+{
+	Flush();
+	std::string result;
+	for(auto &[stack, count] : m_collapsedStacks) {
+		result += stack;
+		result += ' ';
+		result += std::to_string(count);
+		result += '\n';
+	}
+	return result;
+}
@@ -0,0 +1,256 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :script_bundle;
+
+namespace {
+	struct MountedBundle {
+		std::shared_ptr<Lua::ScriptBundle> bundle;
+		// One flag per entry, set if a loose script file with the same path existed when the bundle was mounted
+		std::vector<bool> overridden;
+	};
+};
+static std::shared_mutex g_mountedBundlesMutex;
+static std::vector<MountedBundle> g_mountedBundles;
+static std::atomic<bool> g_hasMountedBundles = false;
+
+std::string Lua::ScriptBundle::GetKey(const std::string_view &path)
+{
+	std::string key;
+	key.reserve(path.size());
+	for(auto c : path) {
+		if(c == '\\')
+			c = '/';
+		if(c == '/' && key.empty())
+			continue;
+		key += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+	if(key.ends_with(DOT_FILE_EXTENSION_PRECOMPILED))
+		key.resize(key.length() - DOT_FILE_EXTENSION_PRECOMPILED.length());
+	else if(key.ends_with(DOT_FILE_EXTENSION))
+		key.resize(key.length() - DOT_FILE_EXTENSION.length());
+	return key;
+}
+
+uint64_t Lua::ScriptBundle::GetHash(const std::string_view &key)
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	for(auto c : key) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool Lua::ScriptBundle::Write(const std::string &path, const std::vector<Script> &scripts)
+{
+	struct PendingEntry {
+		std::string key;
+		const std::string *bytecode;
+		uint64_t hash;
+	};
+	std::vector<PendingEntry> pendingEntries;
+	pendingEntries.reserve(scripts.size());
+	for(auto &script : scripts) {
+		auto key = GetKey(script.path);
+		auto hash = GetHash(key);
+		pendingEntries.push_back({std::move(key), &script.bytecode, hash});
+	}
+	std::sort(pendingEntries.begin(), pendingEntries.end(), [](const PendingEntry &a, const PendingEntry &b) { return (a.hash != b.hash) ? (a.hash < b.hash) : (a.key < b.key); });
+
+	Header header {};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.entryCount = static_cast<uint32_t>(pendingEntries.size());
+
+	std::vector<Entry> entries;
+	entries.reserve(pendingEntries.size());
+	uint64_t pathOffset = sizeof(Header) + pendingEntries.size() * sizeof(Entry);
+	uint64_t pathsSize = 0;
+	for(auto &pending : pendingEntries)
+		pathsSize += pending.key.size();
+	auto dataOffset = pathOffset + pathsSize;
+	if(dataOffset > std::numeric_limits<uint32_t>::max())
+		return false;
+	for(auto &pending : pendingEntries) {
+		Entry entry {};
+		entry.hash = pending.hash;
+		entry.pathOffset = static_cast<uint32_t>(pathOffset);
+		entry.pathLength = static_cast<uint32_t>(pending.key.size());
+		entry.dataOffset = dataOffset;
+		entry.dataSize = pending.bytecode->size();
+		entries.push_back(entry);
+		pathOffset += pending.key.size();
+		dataOffset += pending.bytecode->size();
+	}
+
+	auto lpath = ufile::get_path_from_filename(path);
+	FileManager::CreatePath(lpath.c_str());
+	auto f = FileManager::OpenFile<VFilePtrReal>(path.c_str(), "wb");
+	if(f == nullptr)
+		return false;
+	auto write = [&f](const void *data, size_t size) { return f->Write(data, size) == size; };
+	auto success = write(&header, sizeof(header)) && write(entries.data(), entries.size() * sizeof(Entry));
+	for(auto it = pendingEntries.begin(); success && it != pendingEntries.end(); ++it)
+		success = write(it->key.data(), it->key.size());
+	for(auto it = pendingEntries.begin(); success && it != pendingEntries.end(); ++it)
+		success = write(it->bytecode->data(), it->bytecode->size());
+	if(!success) {
+		// A truncated bundle would only be rejected when it is opened
+		std::filesystem::path filePath = f->GetPath();
+		f = nullptr;
+		std::error_code ec;
+		std::filesystem::remove(filePath, ec);
+		return false;
+	}
+	return true;
+}
+
+std::shared_ptr<Lua::ScriptBundle> Lua::ScriptBundle::Open(const std::string &path, std::string &outErr)
+{
+	auto f = FileManager::OpenFile(path.c_str(), "rb");
+	auto fReal = std::dynamic_pointer_cast<VFilePtrInternalReal>(f);
+	if(fReal == nullptr) {
+		outErr = "cannot open " + path + ": " + ((f == nullptr) ? "File not found" : "File is not located on disk");
+		return nullptr;
+	}
+	auto diskPath = fReal->GetPath();
+	f = nullptr;
+	auto mappedFile = MappedFile::Open(diskPath);
+	if(mappedFile == nullptr) {
+		outErr = "cannot map " + path;
+		return nullptr;
+	}
+	auto *data = mappedFile->GetData();
+	auto size = mappedFile->GetSize();
+	Header header;
+	if(size < sizeof(Header)) {
+		outErr = path + " is not a script bundle";
+		return nullptr;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if(header.magic != MAGIC) {
+		outErr = path + " is not a script bundle";
+		return nullptr;
+	}
+	if(header.version != VERSION) {
+		outErr = path + ": unsupported script bundle version " + std::to_string(header.version);
+		return nullptr;
+	}
+	if(header.entryCount > (size - sizeof(Header)) / sizeof(Entry)) {
+		outErr = path + ": script bundle is truncated";
+		return nullptr;
+	}
+	std::span<const Entry> entries {reinterpret_cast<const Entry *>(data + sizeof(Header)), header.entryCount};
+	for(auto &entry : entries) {
+		if(static_cast<uint64_t>(entry.pathOffset) + entry.pathLength > size || entry.dataOffset > size || entry.dataSize > size - entry.dataOffset) {
+			outErr = path + ": script bundle is corrupt";
+			return nullptr;
+		}
+	}
+	std::shared_ptr<ScriptBundle> bundle {new ScriptBundle {}};
+	bundle->m_path = path;
+	bundle->m_file = std::move(mappedFile);
+	bundle->m_entries = entries;
+	return bundle;
+}
+
+std::string_view Lua::ScriptBundle::GetEntryPath(const Entry &entry) const { return {m_file->GetData() + entry.pathOffset, entry.pathLength}; }
+
+std::optional<std::string_view> Lua::ScriptBundle::Find(const std::string_view &path) const
+{
+	auto key = GetKey(path);
+	return FindByKey(key, GetHash(key));
+}
+
+std::optional<size_t> Lua::ScriptBundle::FindIndexByKey(const std::string_view &key, uint64_t hash) const
+{
+	auto it = std::lower_bound(m_entries.begin(), m_entries.end(), hash, [](const Entry &entry, uint64_t hash) { return entry.hash < hash; });
+	for(; it != m_entries.end() && it->hash == hash; ++it) {
+		if(GetEntryPath(*it) == key)
+			return static_cast<size_t>(it - m_entries.begin());
+	}
+	return {};
+}
+
+std::optional<std::string_view> Lua::ScriptBundle::FindByKey(const std::string_view &key, uint64_t hash) const
+{
+	auto idx = FindIndexByKey(key, hash);
+	if(!idx)
+		return {};
+	auto &entry = m_entries[*idx];
+	return std::string_view {m_file->GetData() + entry.dataOffset, static_cast<size_t>(entry.dataSize)};
+}
+
+// Collects the keys of all loose script files below the script directory
+static void find_loose_scripts(const std::string &path, std::unordered_set<std::string> &outKeys, const std::function<std::string(const std::string_view &)> &getKey)
+{
+	std::vector<std::string> files;
+	std::vector<std::string> dirs;
+	FileManager::FindFiles((Lua::SCRIPT_DIRECTORY_SLASH + path + "*" + Lua::DOT_FILE_EXTENSION).c_str(), &files, nullptr);
+	FileManager::FindFiles((Lua::SCRIPT_DIRECTORY_SLASH + path + "*" + Lua::DOT_FILE_EXTENSION_PRECOMPILED).c_str(), &files, nullptr);
+	FileManager::FindFiles((Lua::SCRIPT_DIRECTORY_SLASH + path + "*").c_str(), nullptr, &dirs);
+	for(auto &f : files)
+		outKeys.insert(getKey(path + f));
+	for(auto &d : dirs)
+		find_loose_scripts(path + d + '/', outKeys, getKey);
+}
+
+size_t Lua::ScriptBundle::GetScriptCount() const { return m_entries.size(); }
+const std::string &Lua::ScriptBundle::GetPath() const { return m_path; }
+
+void Lua::ScriptBundle::Mount(const std::shared_ptr<ScriptBundle> &bundle)
+{
+	// Loose files are looked up once here, so loading a bundled script doesn't need any file system access
+	std::unordered_set<std::string> looseKeys;
+	find_loose_scripts("", looseKeys, &GetKey);
+	MountedBundle mounted {bundle};
+	mounted.overridden.resize(bundle->m_entries.size());
+	for(size_t i = 0; i < bundle->m_entries.size(); ++i)
+		mounted.overridden[i] = looseKeys.contains(std::string {bundle->GetEntryPath(bundle->m_entries[i])});
+
+	std::unique_lock lock {g_mountedBundlesMutex};
+	g_mountedBundles.push_back(std::move(mounted));
+	g_hasMountedBundles = true;
+}
+
+void Lua::ScriptBundle::Unmount(const ScriptBundle &bundle)
+{
+	std::unique_lock lock {g_mountedBundlesMutex};
+	std::erase_if(g_mountedBundles, [&bundle](const MountedBundle &other) { return other.bundle.get() == &bundle; });
+	g_hasMountedBundles = !g_mountedBundles.empty();
+}
+
+void Lua::ScriptBundle::UnmountAll()
+{
+	std::unique_lock lock {g_mountedBundlesMutex};
+	g_mountedBundles.clear();
+	g_hasMountedBundles = false;
+}
+
+bool Lua::ScriptBundle::HasMountedBundles() { return g_hasMountedBundles; }
+
+std::optional<Lua::ScriptBundle::MountedScript> Lua::ScriptBundle::FindMounted(const std::string_view &path)
+{
+	if(!g_hasMountedBundles)
+		return {};
+	auto key = GetKey(path);
+	auto hash = GetHash(key);
+	std::shared_lock lock {g_mountedBundlesMutex};
+	for(auto it = g_mountedBundles.rbegin(); it != g_mountedBundles.rend(); ++it) {
+		auto &bundle = *it->bundle;
+		auto idx = bundle.FindIndexByKey(key, hash);
+		if(!idx)
+			continue;
+		auto &entry = bundle.m_entries[*idx];
+		return MountedScript {it->bundle, std::string_view {bundle.m_file->GetData() + entry.dataOffset, static_cast<size_t>(entry.dataSize)}, it->overridden[*idx]};
+	}
+	return {};
+}
@@ -0,0 +1,182 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :core;
+import :script_manifest;
+
+static std::string to_key(std::string str)
+{
+	for(auto &c : str)
+		c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	return str;
+}
+
+Lua::ScriptManifest &Lua::ScriptManifest::Get()
+{
+	static ScriptManifest manifest;
+	return manifest;
+}
+
+std::string Lua::ScriptManifest::GetDirectoryPath(const std::string_view &dir)
+{
+	auto path = FileManager::GetNormalizedPath(std::string {dir});
+	if(!path.empty() && path.front() == '/')
+		path.erase(path.begin());
+	if(!path.empty() && path.back() != '/')
+		path += '/';
+	return path;
+}
+
+void Lua::ScriptManifest::SplitPath(const std::string_view &path, std::string &outDir, std::string &outName)
+{
+	auto normPath = FileManager::GetNormalizedPath(std::string {path});
+	auto br = normPath.find_last_of('/');
+	if(br == std::string::npos) {
+		outDir = "";
+		outName = normPath;
+	}
+	else {
+		outDir = normPath.substr(0, br + 1);
+		outName = normPath.substr(br + 1);
+	}
+	outDir = GetDirectoryPath(outDir);
+	if(outName.ends_with(DOT_FILE_EXTENSION_PRECOMPILED))
+		outName.resize(outName.length() - DOT_FILE_EXTENSION_PRECOMPILED.length());
+	else if(outName.ends_with(DOT_FILE_EXTENSION))
+		outName.resize(outName.length() - DOT_FILE_EXTENSION.length());
+}
+
+void Lua::ScriptManifest::BuildIndex(const std::string &dir, DirectoryIndex &outIndex)
+{
+	auto path = SCRIPT_DIRECTORY_SLASH + dir;
+	std::vector<std::string> precompiledFiles;
+	std::vector<std::string> sourceFiles;
+	FileManager::FindFiles((path + "*." + FILE_EXTENSION_PRECOMPILED).c_str(), &precompiledFiles, nullptr);
+	FileManager::FindFiles((path + "*." + FILE_EXTENSION).c_str(), &sourceFiles, nullptr);
+	outIndex.scripts.reserve(precompiledFiles.size() + sourceFiles.size());
+	outIndex.nameToIndex.reserve(precompiledFiles.size() + sourceFiles.size());
+	auto add = [&outIndex](const std::string &fileName, size_t extLen) -> Script & {
+		auto name = fileName.substr(0, fileName.length() - extLen);
+		auto it = outIndex.nameToIndex.find(to_key(name));
+		if(it != outIndex.nameToIndex.end())
+			return outIndex.scripts[it->second];
+		outIndex.nameToIndex.insert(std::make_pair(to_key(name), outIndex.scripts.size()));
+		outIndex.scripts.push_back({std::move(name)});
+		return outIndex.scripts.back();
+	};
+	for(auto &f : precompiledFiles)
+		add(f, DOT_FILE_EXTENSION_PRECOMPILED.length()).hasPrecompiled = true;
+	for(auto &f : sourceFiles)
+		add(f, DOT_FILE_EXTENSION.length()).hasSource = true;
+}
+
+std::shared_ptr<Lua::ScriptManifest::DirectoryIndex> Lua::ScriptManifest::GetIndex(const std::string &dir)
+{
+	// Only the key is case-insensitive, the file system has to be queried with the original path
+	auto dirKey = to_key(dir);
+	{
+		std::shared_lock lock {m_mutex};
+		auto it = m_directories.find(dirKey);
+		if(it != m_directories.end())
+			return it->second;
+	}
+	// Index the directory outside of the lock, FindFiles can be slow
+	auto index = std::make_shared<DirectoryIndex>();
+	BuildIndex(dir, *index);
+	std::unique_lock lock {m_mutex};
+	auto it = m_directories.find(dirKey);
+	if(it == m_directories.end())
+		it = m_directories.insert(std::make_pair(dirKey, std::move(index))).first;
+	return it->second;
+}
+
+std::optional<Lua::ScriptManifest::Script> Lua::ScriptManifest::FindScript(const std::string_view &path)
+{
+	std::string dir, name;
+	SplitPath(path, dir, name);
+	auto index = GetIndex(dir);
+	std::shared_lock lock {m_mutex};
+	auto it = index->nameToIndex.find(to_key(name));
+	if(it == index->nameToIndex.end())
+		return {};
+	return index->scripts[it->second];
+}
+
+std::vector<std::string> Lua::ScriptManifest::GetScriptFiles(const std::string_view &dir, bool includePrecompiled)
+{
+	auto index = GetIndex(GetDirectoryPath(dir));
+	std::shared_lock lock {m_mutex};
+	std::vector<std::string> files;
+	files.reserve(index->scripts.size());
+	for(auto &script : index->scripts) {
+		if(includePrecompiled && script.hasPrecompiled)
+			files.push_back(script.name + DOT_FILE_EXTENSION_PRECOMPILED);
+		else if(script.hasSource)
+			files.push_back(script.name + DOT_FILE_EXTENSION);
+	}
+	return files;
+}
+
+void Lua::ScriptManifest::Update(const std::string_view &path)
+{
+	std::string dir, name;
+	SplitPath(path, dir, name);
+	auto scriptPath = SCRIPT_DIRECTORY_SLASH + dir + name;
+	auto hasSource = FileManager::Exists(scriptPath + DOT_FILE_EXTENSION);
+	auto hasPrecompiled = FileManager::Exists(scriptPath + DOT_FILE_EXTENSION_PRECOMPILED);
+
+	std::unique_lock lock {m_mutex};
+	auto itDir = m_directories.find(to_key(dir));
+	if(itDir == m_directories.end())
+		return; // Not indexed yet, the file will be picked up when the directory is indexed
+	auto &index = *itDir->second;
+	auto key = to_key(name);
+	auto it = index.nameToIndex.find(key);
+	if(it == index.nameToIndex.end()) {
+		if(!hasSource && !hasPrecompiled)
+			return;
+		it = index.nameToIndex.insert(std::make_pair(key, index.scripts.size())).first;
+		index.scripts.push_back({name});
+	}
+	if(!hasSource && !hasPrecompiled) {
+		// Swap-remove the entry
+		auto idx = it->second;
+		index.nameToIndex.erase(it);
+		if(idx != index.scripts.size() - 1) {
+			index.scripts[idx] = std::move(index.scripts.back());
+			index.nameToIndex[to_key(index.scripts[idx].name)] = idx;
+		}
+		index.scripts.pop_back();
+		return;
+	}
+	auto &script = index.scripts[it->second];
+	script.hasSource = hasSource;
+	script.hasPrecompiled = hasPrecompiled;
+}
+
+void Lua::ScriptManifest::InvalidateDirectory(const std::string_view &dir)
+{
+	auto key = to_key(GetDirectoryPath(dir));
+	std::unique_lock lock {m_mutex};
+	m_directories.erase(key);
+}
+
+void Lua::ScriptManifest::Clear()
+{
+	std::unique_lock lock {m_mutex};
+	m_directories.clear();
+}
+
+void Lua::ScriptManifest::SetEnabled(bool enabled)
+{
+	m_enabled = enabled;
+	if(!enabled)
+		Clear();
+}
+bool Lua::ScriptManifest::IsEnabled() const { return m_enabled; }
@@ -0,0 +1,365 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :serializer;
+
+// Values are encoded as a tag byte followed by the payload. Lengths and integers are stored as variable-length
+// integers, fixed-size values use the native byte order, since the data is meant to be exchanged between
+// states of the same process.
+namespace {
+	enum class Tag : uint8_t {
+		Nil = 0,
+		False,
+		True,
+		Number,
+		// Numbers without fractional part (zigzag-encoded varint)
+		Integer,
+		String,
+		// Array size (varint), number of hash entries (uint32), array values, key/value pairs
+		Table,
+		// Index of a table that has already been encoded (varint)
+		TableRef,
+		// Userdata type index (varint), data size (uint32), data
+		UserData,
+	};
+}
+
+static void write_varint(std::vector<uint8_t> &buffer, uint64_t value)
+{
+	while(value >= 0x80) {
+		buffer.push_back(static_cast<uint8_t>(value) | 0x80);
+		value >>= 7;
+	}
+	buffer.push_back(static_cast<uint8_t>(value));
+}
+template<typename T>
+static void write_value(std::vector<uint8_t> &buffer, const T &value)
+{
+	auto offset = buffer.size();
+	buffer.resize(offset + sizeof(T));
+	std::memcpy(buffer.data() + offset, &value, sizeof(T));
+}
+static void write_tag(std::vector<uint8_t> &buffer, Tag tag) { buffer.push_back(static_cast<uint8_t>(tag)); }
+
+static bool read_varint(std::span<const uint8_t> data, size_t &offset, uint64_t &outValue)
+{
+	outValue = 0;
+	for(uint32_t shift = 0; shift < 64; shift += 7) {
+		if(offset >= data.size())
+			return false;
+		auto b = data[offset++];
+		outValue |= static_cast<uint64_t>(b & 0x7F) << shift;
+		if((b & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+template<typename T>
+static bool read_value(std::span<const uint8_t> data, size_t &offset, T &outValue)
+{
+	if(data.size() - offset < sizeof(T))
+		return false;
+	std::memcpy(&outValue, data.data() + offset, sizeof(T));
+	offset += sizeof(T);
+	return true;
+}
+
+static bool is_integer(lua_Number n)
+{
+	constexpr lua_Number maxSafeInteger = 9007199254740992.0; // 2^53
+	return std::trunc(n) == n && std::abs(n) < maxSafeInteger && !(n == 0 && std::signbit(n));
+}
+
+void Lua::ValueSerializer::RegisterUserDataType(const std::string &metatableName, const EncodeUserData &encode, const DecodeUserData &decode) { m_userDataTypes.push_back({metatableName, encode, decode}); }
+
+const std::string &Lua::ValueSerializer::GetError() const { return m_error; }
+
+bool Lua::ValueSerializer::SetError(std::string err)
+{
+	m_error = std::move(err);
+	return false;
+}
+
+std::span<const uint8_t> Lua::ValueSerializer::Encode(lua_State *l, int32_t idx, int32_t count)
+{
+	m_buffer.clear();
+	m_tableIds.clear();
+	m_error.clear();
+	if(idx < 0 && idx > LUA_REGISTRYINDEX)
+		idx = lua_gettop(l) + idx + 1;
+	write_varint(m_buffer, static_cast<uint64_t>(std::max(count, 0)));
+	for(int32_t i = 0; i < count; ++i) {
+		if(!EncodeValue(l, idx + i, 0))
+			return {};
+	}
+	return m_buffer;
+}
+
+bool Lua::ValueSerializer::EncodeValue(lua_State *l, int32_t idx, uint32_t depth)
+{
+	auto type = lua_type(l, idx);
+	switch(type) {
+	case LUA_TNIL:
+		write_tag(m_buffer, Tag::Nil);
+		return true;
+	case LUA_TBOOLEAN:
+		write_tag(m_buffer, lua_toboolean(l, idx) ? Tag::True : Tag::False);
+		return true;
+	case LUA_TNUMBER:
+		{
+			auto n = lua_tonumber(l, idx);
+			if(is_integer(n)) {
+				auto i = static_cast<int64_t>(n);
+				write_tag(m_buffer, Tag::Integer);
+				write_varint(m_buffer, (static_cast<uint64_t>(i) << 1) ^ static_cast<uint64_t>(i >> 63));
+			}
+			else {
+				write_tag(m_buffer, Tag::Number);
+				write_value(m_buffer, n);
+			}
+			return true;
+		}
+	case LUA_TSTRING:
+		{
+			size_t len;
+			auto *str = lua_tolstring(l, idx, &len);
+			write_tag(m_buffer, Tag::String);
+			write_varint(m_buffer, len);
+			m_buffer.insert(m_buffer.end(), reinterpret_cast<const uint8_t *>(str), reinterpret_cast<const uint8_t *>(str) + len);
+			return true;
+		}
+	case LUA_TTABLE:
+		return EncodeTable(l, idx, depth);
+	case LUA_TUSERDATA:
+		return EncodeUserDataValue(l, idx);
+	}
+	return SetError(std::string {"cannot encode value of type '"} + lua_typename(l, type) + "'");
+}
+
+bool Lua::ValueSerializer::EncodeTable(lua_State *l, int32_t idx, uint32_t depth)
+{
+	if(depth >= MAX_DEPTH)
+		return SetError("cannot encode table: nesting is too deep");
+	auto *ptr = lua_topointer(l, idx);
+	auto it = m_tableIds.find(ptr);
+	if(it != m_tableIds.end()) {
+		write_tag(m_buffer, Tag::TableRef);
+		write_varint(m_buffer, it->second);
+		return true;
+	}
+	auto id = static_cast<uint32_t>(m_tableIds.size());
+	m_tableIds.emplace(ptr, id);
+	if(!lua_checkstack(l, 3))
+		return SetError("cannot encode table: stack overflow");
+
+	auto arraySize = lua_objlen(l, idx);
+	write_tag(m_buffer, Tag::Table);
+	write_varint(m_buffer, arraySize);
+	// The number of hash entries is only known after iterating the table
+	auto hashCountOffset = m_buffer.size();
+	write_value(m_buffer, uint32_t {0});
+	for(size_t i = 1; i <= arraySize; ++i) {
+		lua_rawgeti(l, idx, static_cast<int>(i));
+		auto success = EncodeValue(l, lua_gettop(l), depth + 1);
+		lua_pop(l, 1);
+		if(!success)
+			return false;
+	}
+
+	uint32_t hashCount = 0;
+	lua_pushnil(l);
+	while(lua_next(l, idx) != 0) {
+		auto top = lua_gettop(l);
+		if(lua_type(l, top - 1) == LUA_TNUMBER) {
+			auto key = lua_tonumber(l, top - 1);
+			if(key >= 1 && key <= static_cast<lua_Number>(arraySize) && std::trunc(key) == key) {
+				// Part of the array, which has already been encoded
+				lua_pop(l, 1);
+				continue;
+			}
+		}
+		if(!EncodeValue(l, top - 1, depth + 1) || !EncodeValue(l, top, depth + 1)) {
+			lua_pop(l, 2);
+			return false;
+		}
+		lua_pop(l, 1);
+		++hashCount;
+	}
+	std::memcpy(m_buffer.data() + hashCountOffset, &hashCount, sizeof(hashCount));
+	return true;
+}
+
+bool Lua::ValueSerializer::EncodeUserDataValue(lua_State *l, int32_t idx)
+{
+	if(lua_getmetatable(l, idx) == 0)
+		return SetError("cannot encode userdata without metatable");
+	for(size_t i = 0; i < m_userDataTypes.size(); ++i) {
+		auto &type = m_userDataTypes[i];
+		luaL_getmetatable(l, type.metatableName.c_str());
+		auto isType = lua_rawequal(l, -1, -2) != 0;
+		lua_pop(l, 1);
+		if(!isType)
+			continue;
+		lua_pop(l, 1);
+		write_tag(m_buffer, Tag::UserData);
+		write_varint(m_buffer, i);
+		auto sizeOffset = m_buffer.size();
+		write_value(m_buffer, uint32_t {0});
+		auto dataOffset = m_buffer.size();
+		if(!type.encode(l, idx, m_buffer))
+			return SetError("cannot encode userdata of type '" + type.metatableName + "'");
+		auto size = static_cast<uint32_t>(m_buffer.size() - dataOffset);
+		std::memcpy(m_buffer.data() + sizeOffset, &size, sizeof(size));
+		return true;
+	}
+	lua_pop(l, 1);
+	return SetError("cannot encode userdata of unregistered type");
+}
+
+std::optional<int32_t> Lua::ValueSerializer::Decode(lua_State *l, std::span<const uint8_t> data)
+{
+	m_error.clear();
+	m_readData = data;
+	m_readOffset = 0;
+	m_numDecodedTables = 0;
+	uint64_t count;
+	// Every value takes up at least one byte
+	if(!read_varint(m_readData, m_readOffset, count) || count > m_readData.size() - m_readOffset) {
+		SetError("invalid value count");
+		return {};
+	}
+	if(!lua_checkstack(l, static_cast<int>(count) + 4)) {
+		SetError("cannot decode values: stack overflow");
+		return {};
+	}
+	auto top = lua_gettop(l);
+	// Decoded tables are kept in a temporary table, so they can be pushed again for table references
+	lua_newtable(l);
+	auto tablesIdx = lua_gettop(l);
+	for(uint64_t i = 0; i < count; ++i) {
+		if(!DecodeValue(l, tablesIdx, 0)) {
+			lua_settop(l, top);
+			return {};
+		}
+	}
+	lua_remove(l, tablesIdx);
+	if(m_readOffset != m_readData.size()) {
+		lua_settop(l, top);
+		SetError("unexpected data after encoded values");
+		return {};
+	}
+	return static_cast<int32_t>(count);
+}
+
+bool Lua::ValueSerializer::DecodeValue(lua_State *l, int32_t tablesIdx, uint32_t depth)
+{
+	uint8_t tag;
+	if(!read_value(m_readData, m_readOffset, tag))
+		return SetError("unexpected end of data");
+	switch(static_cast<Tag>(tag)) {
+	case Tag::Nil:
+		lua_pushnil(l);
+		return true;
+	case Tag::False:
+	case Tag::True:
+		lua_pushboolean(l, static_cast<Tag>(tag) == Tag::True);
+		return true;
+	case Tag::Number:
+		{
+			lua_Number n;
+			if(!read_value(m_readData, m_readOffset, n))
+				return SetError("unexpected end of data");
+			lua_pushnumber(l, n);
+			return true;
+		}
+	case Tag::Integer:
+		{
+			uint64_t v;
+			if(!read_varint(m_readData, m_readOffset, v))
+				return SetError("unexpected end of data");
+			auto i = static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+			lua_pushnumber(l, static_cast<lua_Number>(i));
+			return true;
+		}
+	case Tag::String:
+		{
+			uint64_t len;
+			if(!read_varint(m_readData, m_readOffset, len) || len > m_readData.size() - m_readOffset)
+				return SetError("unexpected end of data");
+			lua_pushlstring(l, reinterpret_cast<const char *>(m_readData.data() + m_readOffset), len);
+			m_readOffset += len;
+			return true;
+		}
+	case Tag::Table:
+		return DecodeTable(l, tablesIdx, depth);
+	case Tag::TableRef:
+		{
+			uint64_t id;
+			if(!read_varint(m_readData, m_readOffset, id) || id >= m_numDecodedTables)
+				return SetError("invalid table reference");
+			lua_rawgeti(l, tablesIdx, static_cast<int>(id + 1));
+			return true;
+		}
+	case Tag::UserData:
+		{
+			uint64_t typeIndex;
+			uint32_t size;
+			if(!read_varint(m_readData, m_readOffset, typeIndex) || typeIndex >= m_userDataTypes.size())
+				return SetError("invalid userdata type");
+			if(!read_value(m_readData, m_readOffset, size) || size > m_readData.size() - m_readOffset)
+				return SetError("unexpected end of data");
+			auto &type = m_userDataTypes[typeIndex];
+			auto top = lua_gettop(l);
+			auto success = type.decode(l, m_readData.subspan(m_readOffset, size));
+			m_readOffset += size;
+			if(!success || lua_gettop(l) != top + 1) {
+				lua_settop(l, top);
+				return SetError("cannot decode userdata of type '" + type.metatableName + "'");
+			}
+			return true;
+		}
+	}
+	return SetError("invalid value tag " + std::to_string(tag));
+}
+
+bool Lua::ValueSerializer::DecodeTable(lua_State *l, int32_t tablesIdx, uint32_t depth)
+{
+	if(depth >= MAX_DEPTH)
+		return SetError("cannot decode table: nesting is too deep");
+	if(!lua_checkstack(l, 3))
+		return SetError("cannot decode table: stack overflow");
+	uint64_t arraySize;
+	uint32_t hashCount;
+	if(!read_varint(m_readData, m_readOffset, arraySize) || !read_value(m_readData, m_readOffset, hashCount))
+		return SetError("unexpected end of data");
+	// Sanity check before pre-allocating the table, every value takes up at least one byte
+	auto remaining = m_readData.size() - m_readOffset;
+	if(arraySize > remaining || hashCount > remaining / 2 || arraySize + hashCount * uint64_t {2} > remaining)
+		return SetError("invalid table size");
+
+	lua_createtable(l, static_cast<int>(arraySize), static_cast<int>(hashCount));
+	auto t = lua_gettop(l);
+	lua_pushvalue(l, t);
+	lua_rawseti(l, tablesIdx, static_cast<int>(++m_numDecodedTables));
+	for(uint64_t i = 1; i <= arraySize; ++i) {
+		if(!DecodeValue(l, tablesIdx, depth + 1))
+			return false;
+		lua_rawseti(l, t, static_cast<int>(i));
+	}
+	for(uint32_t i = 0; i < hashCount; ++i) {
+		if(!DecodeValue(l, tablesIdx, depth + 1))
+			return false;
+		if(lua_isnil(l, -1) || (lua_type(l, -1) == LUA_TNUMBER && std::isnan(lua_tonumber(l, -1))))
+			return SetError("invalid table key");
+		if(!DecodeValue(l, tablesIdx, depth + 1))
+			return false;
+		lua_rawset(l, t);
+	}
+	return true;
+}
@@ -0,0 +1,183 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :state_pool;
+
+void Lua::push_job_value(lua_State *l, const JobValue &value)
+{
+	std::visit(
+	  [l](auto &v) {
+		  using T = std::decay_t<decltype(v)>;
+		  if constexpr(std::is_same_v<T, std::monostate>)
+			  lua_pushnil(l);
+		  else if constexpr(std::is_same_v<T, bool>)
+			  lua_pushboolean(l, v);
+		  else if constexpr(std::is_same_v<T, lua_Number>)
+			  lua_pushnumber(l, v);
+		  else
+			  lua_pushlstring(l, v.data(), v.size());
+	  },
+	  value);
+}
+
+Lua::JobValue Lua::to_job_value(lua_State *l, int32_t idx)
+{
+	switch(lua_type(l, idx)) {
+	case LUA_TBOOLEAN:
+		return static_cast<bool>(lua_toboolean(l, idx));
+	case LUA_TNUMBER:
+		return lua_tonumber(l, idx);
+	case LUA_TSTRING:
+		{
+			size_t len;
+			auto *str = lua_tolstring(l, idx, &len);
+			return std::string {str, len};
+		}
+	}
+	return std::monostate {};
+}
+
+Lua::StatePool::StatePool(uint32_t numStates, const InitCallback &init, AllocatorType allocatorType, size_t queueCapacity)
+{
+	if(numStates == 0)
+		numStates = std::max(std::thread::hardware_concurrency(), 1u);
+	m_workers.reserve(numStates);
+	for(uint32_t i = 0; i < numStates; ++i)
+		m_workers.push_back(std::make_unique<Worker>(queueCapacity));
+	// The states have to be created on their worker threads, we'll wait until all of them have been initialized
+	std::latch initialized {numStates};
+	std::vector<std::exception_ptr> initErrors {numStates};
+	for(uint32_t i = 0; i < numStates; ++i)
+		m_workers[i]->thread = std::thread {[this, i, &init, allocatorType, &initialized, &initErrors]() { Run(i, init, allocatorType, initialized, initErrors[i]); }};
+	initialized.wait();
+	auto it = std::find_if(initErrors.begin(), initErrors.end(), [](const std::exception_ptr &err) { return err != nullptr; });
+	if(it != initErrors.end()) {
+		// The destructor won't be called
+		Shutdown();
+		std::rethrow_exception(*it);
+	}
+}
+
+Lua::StatePool::~StatePool() { Shutdown(); }
+
+void Lua::StatePool::Shutdown()
+{
+	// Remaining jobs are still executed before the workers shut down
+	m_running = false;
+	++m_pendingTasks; // Wakes up idle workers
+	m_pendingTasks.notify_all();
+	for(auto &worker : m_workers)
+		worker->thread.join();
+}
+
+uint32_t Lua::StatePool::GetStateCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+std::future<Lua::JobResult> Lua::StatePool::Submit(std::string functionName, std::vector<JobValue> args) { return Submit(Job {std::move(functionName), std::move(args)}); }
+
+std::future<Lua::JobResult> Lua::StatePool::Submit(Job job)
+{
+	auto *task = new Task {std::move(job)};
+	auto future = task->promise.get_future();
+	// Incremented before the task is pushed, so a worker can never observe a task without a pending count
+	++m_pendingTasks;
+	auto numWorkers = static_cast<uint32_t>(m_workers.size());
+	for(auto start = m_nextWorker++;; std::this_thread::yield()) {
+		auto pushed = false;
+		for(uint32_t i = 0; i < numWorkers; ++i) {
+			if(m_workers[(start + i) % numWorkers]->queue.TryPush(task)) {
+				pushed = true;
+				break;
+			}
+		}
+		if(pushed)
+			break;
+	}
+	m_pendingTasks.notify_one();
+	return future;
+}
+
+Lua::StatePool::Task *Lua::StatePool::PopTask(uint32_t workerIndex)
+{
+	Task *task;
+	if(m_workers[workerIndex]->queue.TryPop(task))
+		return task;
+	// Steal from the other workers
+	auto numWorkers = static_cast<uint32_t>(m_workers.size());
+	for(uint32_t i = 1; i < numWorkers; ++i) {
+		if(m_workers[(workerIndex + i) % numWorkers]->queue.TryPop(task))
+			return task;
+	}
+	return nullptr;
+}
+
+static Lua::JobResult execute_job(lua_State *l, const Lua::Job &job)
+{
+	Lua::JobResult result {};
+	auto top = Lua::GetStackTop(l);
+	Lua::get_global_nested_library(l, job.functionName);
+	if(!Lua::IsFunction(l, -1)) {
+		result.status = Lua::StatusCode::ErrorRun;
+		result.error = "attempt to call '" + job.functionName + "' (a " + std::string {lua_typename(l, lua_type(l, -1))} + " value)";
+		Lua::SetStackTop(l, top);
+		return result;
+	}
+	luaL_checkstack(l, static_cast<int>(job.args.size()), nullptr);
+	for(auto &arg : job.args)
+		Lua::push_job_value(l, arg);
+	result.status = Lua::ProtectedCall(l, static_cast<int32_t>(job.args.size()), job.numResults, result.error);
+	if(result.status == Lua::StatusCode::Ok) {
+		auto numResults = Lua::GetStackTop(l) - top;
+		result.values.reserve(numResults);
+		for(auto i = 1; i <= numResults; ++i)
+			result.values.push_back(Lua::to_job_value(l, top + i));
+	}
+	Lua::SetStackTop(l, top);
+	return result;
+}
+
+void Lua::StatePool::Run(uint32_t workerIndex, const InitCallback &init, AllocatorType allocatorType, std::latch &initialized, std::exception_ptr &outInitError)
+{
+	Interface lua {};
+	try {
+		lua.Open(allocatorType);
+		lua.SetIdentifier("state_pool_" + std::to_string(workerIndex));
+		if(init)
+			init(lua, workerIndex);
+	}
+	catch(...) {
+		// The constructor rethrows the exception once all workers have been initialized
+		outInitError = std::current_exception();
+		initialized.count_down();
+		return;
+	}
+	initialized.count_down();
+
+	auto *l = lua.GetState();
+	for(;;) {
+		auto *task = PopTask(workerIndex);
+		if(task == nullptr) {
+			if(!m_running)
+				break;
+			auto pending = m_pendingTasks.load();
+			if(pending == 0)
+				m_pendingTasks.wait(0);
+			else
+				std::this_thread::yield(); // A task is about to be pushed, or is being executed by another worker
+			continue;
+		}
+		--m_pendingTasks;
+		try {
+			task->promise.set_value(execute_job(l, task->job));
+		}
+		catch(...) {
+			task->promise.set_exception(std::current_exception());
+		}
+		delete task;
+	}
+}
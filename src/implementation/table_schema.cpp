@@ -0,0 +1,142 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+module pragma.lua;
+
+import :table_schema;
+
+static std::atomic<uint64_t> g_nextSchemaId = 1;
+
+Lua::TableSchema::TableSchema() : m_id {g_nextSchemaId++} {}
+
+const std::vector<Lua::TableSchema::Field> &Lua::TableSchema::GetFields() const { return m_fields; }
+
+void Lua::TableSchema::ReadContext::AddError(const std::string &message)
+{
+	if(errors == nullptr)
+		return;
+	std::string strPath;
+	for(size_t i = 0; i < depth; ++i) {
+		auto &segment = path[i];
+		if(segment.field) {
+			if(!strPath.empty())
+				strPath += '.';
+			strPath += segment.field->name;
+		}
+		else
+			strPath += '[' + std::to_string(segment.arrayIndex) + ']';
+	}
+	errors->push_back({std::move(strPath), message});
+}
+
+void Lua::TableSchema::PushKeyTable(lua_State *l) const
+{
+	// The key strings are created once per state and kept in the registry, so reading a field doesn't
+	// require hashing the key. The table is identified by the schema's address, and validated by its id
+	// in case the address has been re-used by another schema.
+	lua_pushlightuserdata(l, const_cast<TableSchema *>(this));
+	lua_rawget(l, LUA_REGISTRYINDEX);
+	if(lua_istable(l, -1)) {
+		lua_rawgeti(l, -1, 0);
+		auto valid = (lua_type(l, -1) == LUA_TNUMBER && static_cast<uint64_t>(lua_tonumber(l, -1)) == m_id);
+		lua_pop(l, 1);
+		if(valid)
+			return;
+	}
+	lua_pop(l, 1);
+
+	lua_createtable(l, static_cast<int>(m_fields.size()), 1);
+	lua_pushnumber(l, static_cast<lua_Number>(m_id));
+	lua_rawseti(l, -2, 0);
+	for(size_t i = 0; i < m_fields.size(); ++i) {
+		auto &name = m_fields[i].name;
+		lua_pushlstring(l, name.data(), name.size());
+		lua_rawseti(l, -2, static_cast<int>(i + 1));
+	}
+	lua_pushlightuserdata(l, const_cast<TableSchema *>(this));
+	lua_pushvalue(l, -2);
+	lua_rawset(l, LUA_REGISTRYINDEX);
+}
+
+void Lua::TableSchema::Release(lua_State *l) const
+{
+	lua_pushlightuserdata(l, const_cast<TableSchema *>(this));
+	lua_pushnil(l);
+	lua_rawset(l, LUA_REGISTRYINDEX);
+}
+
+void Lua::TableSchema::ReadTable(lua_State *l, int32_t tableIdx, void *object, ReadContext &context) const
+{
+	if(context.depth >= ReadContext::MAX_DEPTH) {
+		context.AddError("maximum nesting depth exceeded");
+		return;
+	}
+	luaL_checkstack(l, 3, nullptr);
+	PushKeyTable(l);
+	auto keysIdx = lua_gettop(l);
+	for(size_t i = 0; i < m_fields.size(); ++i) {
+		auto &field = m_fields[i];
+		context.path[context.depth++] = {&field, 0};
+		lua_rawgeti(l, keysIdx, static_cast<int>(i + 1));
+		lua_gettable(l, tableIdx);
+		auto valueIdx = lua_gettop(l);
+		auto *dst = field.resolve(object, field);
+		if(lua_isnil(l, valueIdx)) {
+			if(field.applyDefault)
+				field.applyDefault(dst);
+			else if(field.required)
+				context.AddError("required field is missing");
+		}
+		else if(!field.read(l, valueIdx, dst, field, context)) {
+			context.AddError(std::string {field.typeName} + " expected, got " + lua_typename(l, lua_type(l, valueIdx)));
+			if(field.applyDefault)
+				field.applyDefault(dst);
+		}
+		lua_pop(l, 1);
+		--context.depth;
+	}
+	lua_pop(l, 1);
+}
+
+namespace {
+	struct ReadCallData {
+		const Lua::TableSchema *schema = nullptr;
+		void *object = nullptr;
+		Lua::TableSchema::ReadContext *context = nullptr;
+	};
+}
+
+static int read_table(lua_State *l)
+{
+	auto &data = *static_cast<ReadCallData *>(lua_touserdata(l, 2));
+	data.schema->ReadTable(l, 1, data.object, *data.context);
+	return 0;
+}
+
+Lua::StatusCode Lua::TableSchema::Read(lua_State *l, int32_t idx, void *object, std::vector<FieldError> &outErrors) const
+{
+	if(!lua_istable(l, idx)) {
+		outErrors.push_back({"", std::string {"table expected, got "} + lua_typename(l, lua_type(l, idx))});
+		return StatusCode::Ok;
+	}
+	ReadContext context {};
+	context.errors = &outErrors;
+	ReadCallData data {this, object, &context};
+	if(idx < 0 && idx > LUA_REGISTRYINDEX)
+		idx = lua_gettop(l) + idx + 1;
+	push_cached_c_function(l, read_table);
+	lua_pushvalue(l, idx);
+	lua_pushlightuserdata(l, &data);
+	auto r = static_cast<StatusCode>(lua_pcall(l, 2, 0, 0));
+	if(r != StatusCode::Ok) {
+		// The path of the context still points to the field that caused the error
+		auto *msg = lua_tostring(l, -1);
+		context.AddError(msg ? msg : "unknown error");
+		lua_pop(l, 1);
+	}
+	return r;
+}
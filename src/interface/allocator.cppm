@@ -0,0 +1,67 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:allocator;
+
+export import std.compat;
+
+export namespace Lua {
+	enum class AllocatorType : uint8_t {
+		Default = 0,
+		Pool,
+	};
+
+	// Allocator for a single lua state. Small blocks are served from per-size-class free lists
+	// carved out of larger pages, larger blocks fall back to malloc. Memory of small blocks is kept
+	// for re-use and only released when the allocator is destroyed.
+	// The allocator is not thread-safe, which is fine since a lua state must not be used by multiple threads at once.
+	class DLLLUA PoolAllocator {
+	  public:
+		static constexpr size_t SIZE_CLASS_GRANULARITY = 16;
+		static constexpr size_t MAX_SMALL_BLOCK_SIZE = 512;
+		static constexpr size_t SIZE_CLASS_COUNT = MAX_SMALL_BLOCK_SIZE / SIZE_CLASS_GRANULARITY;
+		static constexpr size_t PAGE_SIZE = 64 * 1024;
+		struct DLLLUA Stats {
+			size_t liveBytes = 0;
+			size_t peakBytes = 0;
+			// Bytes reserved for small blocks, including blocks that are currently unused
+			size_t reservedPageBytes = 0;
+			uint64_t allocationCount = 0;
+			uint64_t largeAllocationCount = 0;
+		};
+		// lua_Alloc-compatible function, the user data must point to a PoolAllocator
+		static void *Allocate(void *ud, void *ptr, size_t osize, size_t nsize);
+
+		PoolAllocator() = default;
+		PoolAllocator(const PoolAllocator &) = delete;
+		PoolAllocator &operator=(const PoolAllocator &) = delete;
+		~PoolAllocator();
+		const Stats &GetStats() const;
+	  private:
+		struct FreeListNode {
+			FreeListNode *next;
+		};
+		struct SizeClass {
+			FreeListNode *freeList = nullptr;
+			char *bumpPtr = nullptr;
+			char *bumpEnd = nullptr;
+		};
+		static constexpr size_t GetSizeClassIndex(size_t size) { return (size - 1) / SIZE_CLASS_GRANULARITY; }
+		static constexpr bool IsSmallBlock(size_t size) { return size > 0 && size <= MAX_SMALL_BLOCK_SIZE; }
+		void *AllocateBlock(size_t size);
+		void FreeBlock(void *ptr, size_t size);
+		void *Reallocate(void *ptr, size_t osize, size_t nsize);
+
+		std::array<SizeClass, SIZE_CLASS_COUNT> m_sizeClasses {};
+		std::vector<void *> m_pages;
+		Stats m_stats {};
+	};
+
+	// Creates a new state that allocates all of its memory through the given allocator, which must outlive the state.
+	// Returns nullptr if the lua runtime does not support custom allocators (e.g. LuaJIT on 64-bit without GC64).
+	DLLLUA lua_State *CreateState(PoolAllocator &allocator);
+};
@@ -0,0 +1,174 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:array;
+
+export import :core;
+
+export namespace Lua {
+	// Element types that can be transferred in bulk: Native types, and trivially copyable structs (e.g. vectors), which
+	// are converted through luabind and therefore have to be registered as a class.
+	template<typename T>
+	concept is_array_element = is_native_type<T> || (std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T> && !std::is_pointer_v<T>);
+
+	// Pushes the table of the LuaJIT ffi library, loading it if no script has required it yet. Returns false and pushes nothing if the FFI is not available.
+	DLLLUA bool push_ffi_library(lua_State *l);
+	DLLLUA bool push_ffi_array(lua_State *l, const char *cType, const void *data, size_t count, size_t elementSize);
+
+	// Pushes a new (1-based) array table containing all values. The table is pre-sized and the stack is only checked once.
+	template<typename T>
+	    requires(is_array_element<T>)
+	void PushArray(lua_State *l, std::span<const T> values)
+	{
+		luaL_checkstack(l, 2, nullptr);
+		lua_createtable(l, static_cast<int>(values.size()), 0);
+		int i = 1;
+		for(auto &v : values) {
+			if constexpr(std::is_same_v<T, bool>)
+				lua_pushboolean(l, v);
+			else if constexpr(std::is_integral_v<T>)
+				lua_pushinteger(l, static_cast<lua_Integer>(v));
+			else if constexpr(std::is_arithmetic_v<T>)
+				lua_pushnumber(l, static_cast<lua_Number>(v));
+			else if constexpr(std::is_same_v<T, std::string>)
+				lua_pushlstring(l, v.data(), v.size());
+			else if constexpr(is_native_type<T>)
+				Push<T>(l, v);
+			else
+				luabind::object(l, v).push(l);
+			lua_rawseti(l, -2, i++);
+		}
+	}
+
+	// std::vector<bool> is not contiguous and has to be converted first
+	template<typename T>
+	    requires(is_array_element<T> && !std::is_same_v<T, bool>)
+	void PushArray(lua_State *l, const std::vector<T> &values)
+	{
+		PushArray(l, std::span<const T> {values});
+	}
+
+	// Reads the array table at the given stack index into 'outValues'. Returns false if the value is not a table or if an
+	// element has the wrong type (or isn't representable by an integral T), in which case 'outValues' only contains the elements before it.
+	template<typename T>
+	    requires(is_array_element<T> && !std::is_same_v<T, const char *>)
+	bool ToArray(lua_State *l, int32_t idx, std::vector<T> &outValues)
+	{
+		outValues.clear();
+		if(!lua_istable(l, idx))
+			return false;
+		auto n = lua_objlen(l, idx);
+		outValues.reserve(n);
+		luaL_checkstack(l, 1, nullptr);
+		for(size_t i = 1; i <= n; ++i) {
+			lua_rawgeti(l, idx, static_cast<int>(i));
+			auto valid = true;
+			if constexpr(std::is_same_v<T, bool>) {
+				valid = lua_isboolean(l, -1);
+				if(valid)
+					outValues.push_back(lua_toboolean(l, -1) != 0);
+			}
+			else if constexpr(std::is_integral_v<T>) {
+				valid = lua_type(l, -1) == LUA_TNUMBER;
+				if(valid) {
+					// Fractional values (e.g. 1.5) and values outside of the range of T are rejected instead of being truncated.
+					// The upper bound is exclusive, since the maximum of 64-bit types isn't representable as a lua_Number.
+					auto v = lua_tonumber(l, -1);
+					valid = std::trunc(v) == v && v >= static_cast<lua_Number>(std::numeric_limits<T>::min()) && v < static_cast<lua_Number>(std::numeric_limits<T>::max() / 2 + 1) * 2;
+					if(valid)
+						outValues.push_back(static_cast<T>(v));
+				}
+			}
+			else if constexpr(std::is_arithmetic_v<T>) {
+				valid = lua_type(l, -1) == LUA_TNUMBER;
+				if(valid)
+					outValues.push_back(static_cast<T>(lua_tonumber(l, -1)));
+			}
+			else if constexpr(std::is_same_v<T, std::string>) {
+				valid = lua_type(l, -1) == LUA_TSTRING;
+				if(valid) {
+					size_t len;
+					auto *str = lua_tolstring(l, -1, &len);
+					outValues.emplace_back(str, len);
+				}
+			}
+			else {
+				valid = lua_isuserdata(l, -1);
+				if(valid) {
+					luabind::object o(luabind::from_stack(l, -1));
+					auto pV = luabind::object_cast_nothrow<T *>(o);
+					valid = (pV != boost::none && pV.get() != nullptr);
+					if(valid)
+						outValues.push_back(*pV.get());
+				}
+			}
+			lua_pop(l, 1);
+			if(!valid)
+				return false;
+		}
+		return true;
+	}
+
+	// Name of the C type of an arithmetic type for the LuaJIT FFI, e.g. "float" or "uint16_t"
+	template<typename T>
+	constexpr const char *get_ffi_type_name()
+	{
+		if constexpr(std::is_same_v<T, bool>)
+			return "bool";
+		else if constexpr(std::is_floating_point_v<T>)
+			return (sizeof(T) == sizeof(float)) ? "float" : "double";
+		else if constexpr(std::is_integral_v<T> && std::is_signed_v<T>) {
+			switch(sizeof(T)) {
+			case 1:
+				return "int8_t";
+			case 2:
+				return "int16_t";
+			case 4:
+				return "int32_t";
+			default:
+				return "int64_t";
+			}
+		}
+		else if constexpr(std::is_integral_v<T>) {
+			switch(sizeof(T)) {
+			case 1:
+				return "uint8_t";
+			case 2:
+				return "uint16_t";
+			case 4:
+				return "uint32_t";
+			default:
+				return "uint64_t";
+			}
+		}
+		else
+			return nullptr;
+	}
+
+	// Pushes a C array (cdata, zero-based) with a copy of the values instead of a table. This requires only a single memory copy
+	// and is much cheaper than a table for large arrays, but can only be used by scripts through the FFI.
+	// If the memory outlives the script's use of it, BufferBridge::PushArrayView avoids the copy entirely.
+	// For structs, 'cType' has to name a type that has been declared with ffi.cdef and has the same layout.
+	// Returns false and pushes nothing if the FFI is not available (e.g. without LuaJIT) or the type sizes don't match.
+	template<typename T>
+	    requires((is_array_element<T> && !is_native_type<T>) || std::is_arithmetic_v<T>)
+	bool PushArrayCData(lua_State *l, std::span<const T> values, const char *cType = nullptr)
+	{
+		if(cType == nullptr)
+			cType = get_ffi_type_name<T>();
+		if(cType == nullptr)
+			return false;
+		return push_ffi_array(l, cType, values.data(), values.size(), sizeof(T));
+	}
+
+	template<typename T>
+	    requires(((is_array_element<T> && !is_native_type<T>) || std::is_arithmetic_v<T>) && !std::is_same_v<T, bool>)
+	bool PushArrayCData(lua_State *l, const std::vector<T> &values, const char *cType = nullptr)
+	{
+		return PushArrayCData(l, std::span<const T> {values}, cType);
+	}
+};
@@ -0,0 +1,170 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:buffer_bridge;
+
+export import :array;
+
+export namespace Lua {
+	// Hands memory that is owned by C++ to scripts without copying it. Scripts receive a NativeBuffer object with
+	// bounds-checked element access (Get, Set, GetSize, ToTable) and, with LuaJIT, FFI access (GetView, GetPointer).
+	// Every registration is identified by a slot index and a generation. Once a buffer has been released, all script
+	// references to it raise a lua error on access instead of touching the memory.
+	// Views returned by GetView index the memory through the FFI and check the generation and bounds on every access,
+	// so they can be kept by scripts and follow Update. Raw pointers returned by GetPointer are not tracked and must be
+	// re-fetched in every call, they must not be stored beyond it.
+	// Must only be used from the thread that runs the lua state.
+	class DLLLUA BufferBridge {
+	  public:
+		static constexpr const char *TYPE_NAME = "NativeBuffer";
+		enum class ElementType : uint8_t {
+			Int8 = 0,
+			UInt8,
+			Int16,
+			UInt16,
+			Int32,
+			UInt32,
+			Int64,
+			UInt64,
+			Float,
+			Double,
+			// Only accessible through GetPointer
+			Struct,
+		};
+		struct DLLLUA Handle {
+			uint32_t index = std::numeric_limits<uint32_t>::max();
+			uint32_t generation = 0;
+		};
+		template<typename T>
+		static constexpr ElementType GetElementType();
+
+		BufferBridge(lua_State *l);
+		BufferBridge(const BufferBridge &) = delete;
+		BufferBridge &operator=(const BufferBridge &) = delete;
+		~BufferBridge();
+		// Returns the buffer bridge of the lua state, or nullptr if there is none
+		static BufferBridge *Get(lua_State *l);
+
+		// The memory has to stay valid until the buffer is released or updated. 'cType' is the FFI type name of an element,
+		// structs have to be declared with ffi.cdef by the scripts. If it is empty, GetPointer returns a void pointer.
+		Handle Register(void *data, size_t count, ElementType type, size_t elementSize, std::string cType, bool readOnly = false);
+		// Buffers of const elements are read-only for scripts
+		template<typename T>
+		    requires(!std::is_same_v<std::remove_const_t<T>, bool> && (std::is_arithmetic_v<T> || (std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T> && !std::is_pointer_v<T>)))
+		Handle Register(std::span<T> data, std::string cType = {});
+		// Points the buffer to new memory (e.g. after a container has been reallocated). Existing script references stay valid.
+		bool Update(Handle handle, void *data, size_t count);
+		// Invalidates all script references to the buffer
+		void Release(Handle handle);
+		bool IsValid(Handle handle) const;
+		// Pushes a new NativeBuffer object, or nil if the handle is not valid
+		void Push(lua_State *l, Handle handle) const;
+		// Pushes a view of the buffer (see GetView) without creating a NativeBuffer object. Returns false and pushes nothing
+		// if the FFI is not available, the handle is not valid or the buffer has no C type.
+		bool PushView(lua_State *l, Handle handle) const;
+		// Zero-copy alternative to PushArrayCData: Registers the memory and pushes a view of it. The memory has to stay valid
+		// until the returned handle is released. Returns an invalid handle and pushes nothing if no view could be created.
+		template<typename T>
+		    requires(!std::is_same_v<std::remove_const_t<T>, bool> && (std::is_arithmetic_v<T> || (std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T> && !std::is_pointer_v<T>)))
+		Handle PushArrayView(lua_State *l, std::span<T> data, std::string cType = {});
+		// Returns the handle of the NativeBuffer object at the given stack index, or an invalid handle if it isn't one
+		static Handle GetHandle(lua_State *l, int32_t idx);
+	  private:
+		// Mirrors the state of a slot in memory that is read by views through the FFI, the layout has to match the
+		// declaration in the view script. Headers are allocated in blocks of lua userdata, so views can keep them alive.
+		struct Header {
+			void *data = nullptr;
+			uint64_t count = 0;
+			uint32_t generation = 0;
+			uint32_t readOnly = 0;
+		};
+		static constexpr uint32_t HEADER_BLOCK_SIZE = 64;
+		struct HeaderBlock {
+			int32_t reference = LUA_NOREF;
+			Header *headers = nullptr;
+		};
+		struct Slot {
+			void *data = nullptr;
+			size_t count = 0;
+			size_t elementSize = 0;
+			std::string cType;
+			uint32_t generation = 1;
+			ElementType type = ElementType::UInt8;
+			bool active = false;
+			bool readOnly = false;
+		};
+		void ReserveHeaders(uint32_t count);
+		void SyncHeader(uint32_t index);
+		Slot *FindSlot(Handle handle);
+		const Slot *FindSlot(Handle handle) const;
+		static Slot &CheckSlot(lua_State *l, int32_t idx);
+		static size_t CheckIndex(lua_State *l, const Slot &slot, int32_t idx);
+		static void PushElement(lua_State *l, const Slot &slot, size_t index);
+		static int32_t LuaIsValid(lua_State *l);
+		static int32_t LuaGetSize(lua_State *l);
+		static int32_t LuaGetByteSize(lua_State *l);
+		static int32_t LuaIsReadOnly(lua_State *l);
+		static int32_t LuaGet(lua_State *l);
+		static int32_t LuaSet(lua_State *l);
+		static int32_t LuaToTable(lua_State *l);
+		static int32_t LuaGetView(lua_State *l);
+		static int32_t LuaGetPointer(lua_State *l);
+		static int32_t LuaToString(lua_State *l);
+
+		lua_State *m_state = nullptr;
+		std::vector<Slot> m_slots;
+		std::vector<uint32_t> m_freeSlots;
+		std::vector<HeaderBlock> m_headerBlocks;
+	};
+
+	template<typename T>
+	constexpr BufferBridge::ElementType BufferBridge::GetElementType()
+	{
+		using TBase = std::remove_const_t<T>;
+		if constexpr(std::is_floating_point_v<TBase>)
+			return (sizeof(TBase) == sizeof(float)) ? ElementType::Float : ElementType::Double;
+		else if constexpr(std::is_integral_v<TBase>) {
+			constexpr auto isSigned = std::is_signed_v<TBase>;
+			switch(sizeof(TBase)) {
+			case 1:
+				return isSigned ? ElementType::Int8 : ElementType::UInt8;
+			case 2:
+				return isSigned ? ElementType::Int16 : ElementType::UInt16;
+			case 4:
+				return isSigned ? ElementType::Int32 : ElementType::UInt32;
+			default:
+				return isSigned ? ElementType::Int64 : ElementType::UInt64;
+			}
+		}
+		else
+			return ElementType::Struct;
+	}
+
+	template<typename T>
+	    requires(!std::is_same_v<std::remove_const_t<T>, bool> && (std::is_arithmetic_v<T> || (std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T> && !std::is_pointer_v<T>)))
+	BufferBridge::Handle BufferBridge::Register(std::span<T> data, std::string cType)
+	{
+		using TBase = std::remove_const_t<T>;
+		if(cType.empty()) {
+			if constexpr(std::is_arithmetic_v<TBase>)
+				cType = get_ffi_type_name<TBase>();
+		}
+		return Register(const_cast<TBase *>(data.data()), data.size(), GetElementType<T>(), sizeof(T), std::move(cType), std::is_const_v<T>);
+	}
+
+	template<typename T>
+	    requires(!std::is_same_v<std::remove_const_t<T>, bool> && (std::is_arithmetic_v<T> || (std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T> && !std::is_pointer_v<T>)))
+	BufferBridge::Handle BufferBridge::PushArrayView(lua_State *l, std::span<T> data, std::string cType)
+	{
+		auto handle = Register(data, std::move(cType));
+		if(!PushView(l, handle)) {
+			Release(handle);
+			return {};
+		}
+		return handle;
+	}
+};
@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:bytecode_cache;
+
+export import std.compat;
+
+export namespace Lua {
+	// Process-wide cache of compiled chunks, shared by all lua states.
+	// Entries are keyed by the requested script path, so a hit doesn't have to resolve or open the file. They are
+	// invalidated if the modification time or size of the file they were loaded from changes. Files inside of archives
+	// have no modification time and are never cached.
+	// Note: A file that is added later and would take precedence (e.g. a new precompiled file) is only picked up
+	// once the entry has been removed.
+	class DLLLUA BytecodeCache {
+	  public:
+		static constexpr size_t DEFAULT_MAX_SIZE = 64 * 1024 * 1024;
+		struct DLLLUA FileStamp {
+			int64_t lastWriteTime = 0;
+			uint64_t fileSize = 0;
+			bool operator==(const FileStamp &other) const { return lastWriteTime == other.lastWriteTime && fileSize == other.fileSize; }
+		};
+		struct DLLLUA Chunk {
+			std::string bytecode;
+			// Normalized path of the file the chunk was loaded from, relative to the program directory
+			std::string resolvedPath;
+			std::string chunkName;
+			// Absolute path on disk, used to validate the entry
+			std::string diskPath;
+			FileStamp stamp;
+		};
+		struct DLLLUA Stats {
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t evictions = 0;
+			size_t entryCount = 0;
+			size_t sizeInBytes = 0;
+			size_t maxSizeInBytes = 0;
+		};
+		static BytecodeCache &Get();
+		// 'path' is the normalized requested path (including SCRIPT_DIRECTORY). States that don't look for precompiled
+		// files may resolve the same path to a different file, so they use a separate key.
+		static std::string GetKey(const std::string_view &path, bool precompiledFiles);
+		static std::optional<FileStamp> GetFileStamp(const std::string &diskPath);
+
+		// Returns the cached chunk, or nullptr if there is no entry or the file has changed since it was cached
+		std::shared_ptr<const Chunk> Find(const std::string &key);
+		void Insert(const std::string &key, Chunk chunk);
+		// Removes the entries of a requested path for both kinds of keys
+		void Remove(const std::string_view &path);
+		void Clear();
+
+		void SetEnabled(bool enabled);
+		bool IsEnabled() const;
+		void SetMaxSize(size_t maxSizeInBytes);
+		Stats GetStats() const;
+		void ResetStats();
+	  private:
+		BytecodeCache() = default;
+		struct Entry {
+			std::string key;
+			std::shared_ptr<const Chunk> chunk;
+		};
+		void Erase(std::list<Entry>::iterator it);
+		void Evict();
+
+		mutable std::mutex m_mutex;
+		std::list<Entry> m_lru; // Most recently used entries are at the front
+		std::unordered_map<std::string, std::list<Entry>::iterator> m_entries;
+		size_t m_size = 0;
+		size_t m_maxSize = DEFAULT_MAX_SIZE;
+		std::atomic<bool> m_enabled = true;
+		std::atomic<uint64_t> m_hits = 0;
+		std::atomic<uint64_t> m_misses = 0;
+		std::atomic<uint64_t> m_evictions = 0;
+	};
+
+	// Dumps the function at the top of the stack into a bytecode string. Debug information is included unless 'strip' is set,
+	// which is only supported by LuaJIT.
+	DLLLUA bool dump_bytecode(lua_State *l, std::string &outBytecode, bool strip = false);
+};
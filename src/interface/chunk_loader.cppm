@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:chunk_loader;
+
+export import :core;
+
+export namespace Lua {
+	// Read-only memory mapping of a file on disk
+	class DLLLUA MappedFile {
+	  public:
+		static std::unique_ptr<MappedFile> Open(const std::string &path);
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+		~MappedFile();
+		const char *GetData() const;
+		size_t GetSize() const;
+	  private:
+		MappedFile() = default;
+		const char *m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void *m_fileHandle = nullptr;
+		void *m_mappingHandle = nullptr;
+#endif
+	};
+
+	// Files smaller than this are streamed instead of being memory-mapped
+	constexpr size_t MIN_MAPPED_CHUNK_SIZE = 64 * 1024;
+	constexpr size_t CHUNK_READ_BUFFER_SIZE = 16 * 1024;
+
+	DLLLUA const char *get_load_mode_string(LoadMode mode);
+	// Loads a chunk from the given file without copying its contents into an intermediate buffer.
+	// Files on disk are memory-mapped, all other files are streamed in fixed-size chunks.
+	// If 'outReadTime' is specified, it receives the time that was spent on reading (or mapping) the file.
+	DLLLUA StatusCode load_chunk(lua_State *l, VFilePtr &f, const std::string &chunkName, LoadMode mode = LoadMode::Any, std::chrono::nanoseconds *outReadTime = nullptr);
+	DLLLUA StatusCode load_chunk(lua_State *l, const char *data, size_t size, const std::string &chunkName, LoadMode mode = LoadMode::Any);
+};
@@ -0,0 +1,40 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:compiler;
+
+export import :core;
+
+export namespace Lua {
+	struct DLLLUA CompileResult {
+		enum class Status : uint8_t {
+			Compiled = 0,
+			UpToDate,
+			Failed,
+		};
+		// Paths are relative to SCRIPT_DIRECTORY
+		std::string sourcePath;
+		std::string outputPath;
+		Status status = Status::Failed;
+		std::string error;
+		std::chrono::nanoseconds duration {0};
+	};
+
+	struct DLLLUA BatchCompileInfo {
+		// Sub-directory of SCRIPT_DIRECTORY to compile, including all of its sub-directories
+		std::string subPath;
+		// 0 = Use the number of hardware threads
+		uint32_t threadCount = 0;
+		// If false, files whose precompiled output is newer than the source file are skipped
+		bool force = false;
+		// Called once for every file after it has been processed. Calls are serialized, but may come from any worker thread.
+		std::function<void(const CompileResult &)> onFileProcessed = nullptr;
+	};
+
+	// Compiles all lua-files in the given directory to precompiled files on a pool of worker threads, with one lua state per worker
+	DLLLUA std::vector<CompileResult> compile_files(const BatchCompileInfo &info);
+};
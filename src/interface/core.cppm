@@ -15,30 +15,13 @@ export import luabind;
 	namespace Lua {                                                                                                                                                                                                                                                                              \
 		inline auto Check##typeName(lua_State *l, int n)                                                                                                                                                                                                                                         \
 		{                                                                                                                                                                                                                                                                                        \
-			Lua::CheckUserData(l, n);                                                                                                                                                                                                                                                            \
-			luabind::object o(luabind::from_stack(l, n));                                                                                                                                                                                                                                        \
-			auto pV = luabind::object_cast_nothrow<internalType *>(o);                                                                                                                                                                                                                           \
-			if(pV == boost::none) {                                                                                                                                                                                                                                                              \
-				std::string err = #typeName " expected, got ";                                                                                                                                                                                                                                   \
-				err += Lua::GetTypeString(l, n);                                                                                                                                                                                                                                                 \
-				luaL_argerror(l, n, err.c_str());                                                                                                                                                                                                                                                \
-			}                                                                                                                                                                                                                                                                                    \
-			return pV.get();                                                                                                                                                                                                                                                                     \
-		}                                                                                                                                                                                                                                                                                        \
-		inline auto Is##typeName(lua_State *l, int n)                                                                                                                                                                                                                                            \
-		{                                                                                                                                                                                                                                                                                        \
-			if(!lua_isuserdata(l, n))                                                                                                                                                                                                                                                            \
-				return false;                                                                                                                                                                                                                                                                    \
-			luabind::object o(luabind::from_stack(l, n));                                                                                                                                                                                                                                        \
-			auto pV = luabind::object_cast_nothrow<internalType *>(o);                                                                                                                                                                                                                           \
-			return (pV != boost::none) ? true : false;                                                                                                                                                                                                                                           \
-		}                                                                                                                                                                                                                                                                                        \
-		inline auto Get##typeName(lua_State *l, int n)                                                                                                                                                                                                                                           \
-		{                                                                                                                                                                                                                                                                                        \
-			luabind::object o(luabind::from_stack(l, n));                                                                                                                                                                                                                                        \
-			auto pV = luabind::object_cast_nothrow<internalType *>(o);                                                                                                                                                                                                                           \
-			return pV.get();                                                                                                                                                                                                                                                                     \
+			auto *pV = Lua::get_registered_instance<internalType>(l, n);                                                                                                                                                                                                                         \
+			if(pV == nullptr)                                                                                                                                                                                                                                                                    \
+				luaL_argerror(l, n, lua_pushfstring(l, #typeName " expected, got %s", Lua::GetTypeString(l, n)));                                                                                                                                                                                \
+			return pV;                                                                                                                                                                                                                                                                           \
 		}                                                                                                                                                                                                                                                                                        \
+		inline auto Is##typeName(lua_State *l, int n) { return Lua::get_registered_instance<internalType>(l, n) != nullptr; }                                                                                                                                                                    \
+		inline auto Get##typeName(lua_State *l, int n) { return Lua::get_registered_instance<internalType>(l, n); }                                                                                                                                                                              \
 	};
 
 #ifndef LUA_OK
@@ -61,6 +44,11 @@ export {
 			ErrorErrorHandler = LUA_ERRERR,
 			ErrorFile = LUA_ERRFILE
 		};
+		enum class DLLLUA LoadMode : uint8_t {
+			Any = 0,
+			TextOnly,
+			BinaryOnly,
+		};
 		enum class DLLLUA Type : decltype(LUA_TNONE) { None = LUA_TNONE, Nil = LUA_TNIL, Bool = LUA_TBOOLEAN, LightUserData = LUA_TLIGHTUSERDATA, Number = LUA_TNUMBER, String = LUA_TSTRING, Table = LUA_TTABLE, Function = LUA_TFUNCTION, UserData = LUA_TUSERDATA, Thread = LUA_TTHREAD };
 
 		CLASS_ENUM_COMPAT std::string SCRIPT_DIRECTORY;
@@ -79,7 +67,42 @@ export {
 		DLLLUA lua_State *CreateState();
 		DLLLUA void CloseState(lua_State *lua);
 		DLLLUA void Call(lua_State *lua, int32_t nargs, int32_t nresults);
+		// Non-owning reference to a callable object. The referenced object must outlive the reference.
+		template<typename TSignature>
+		class FunctionRef;
+		template<typename TRet, typename... TArgs>
+		class FunctionRef<TRet(TArgs...)> {
+		  public:
+			FunctionRef() = default;
+			template<typename TFunc>
+			    requires(!std::is_same_v<std::remove_cvref_t<TFunc>, FunctionRef> && std::is_invocable_r_v<TRet, TFunc &, TArgs...>)
+			FunctionRef(TFunc &&f)
+			    : m_object {const_cast<void *>(static_cast<const void *>(std::addressof(f)))}, m_callback {[](void *obj, TArgs... args) -> TRet { return (*static_cast<std::remove_reference_t<TFunc> *>(obj))(std::forward<TArgs>(args)...); }}
+			{
+			}
+			TRet operator()(TArgs... args) const { return m_callback(m_object, std::forward<TArgs>(args)...); }
+			explicit operator bool() const { return m_callback != nullptr; }
+		  private:
+			void *m_object = nullptr;
+			TRet (*m_callback)(void *, TArgs...) = nullptr;
+		};
+		using PushArgsCallback = FunctionRef<StatusCode(lua_State *)>;
+		DLLLUA StatusCode protected_call(lua_State *lua, PushArgsCallback pushFuncArgs, int32_t numResults, std::string &outErr, int32_t (*traceback)(lua_State *) = nullptr, void (*pushArgErrorHandler)(lua_State *, StatusCode) = nullptr);
+
 		// Function and function arguments have to be pushed inside 'pushFuncArgs'-callback!
+		// Callables are passed by reference, so this overload never allocates on the success path.
+		// std::function objects go through the overload below, where an empty function means that the function has already been pushed.
+		// The same applies to null function pointers.
+		template<typename TPushFuncArgs>
+		    requires(std::is_invocable_r_v<StatusCode, TPushFuncArgs &, lua_State *> && !std::is_same_v<std::remove_cvref_t<TPushFuncArgs>, std::function<StatusCode(lua_State *)>>)
+		StatusCode ProtectedCall(lua_State *lua, TPushFuncArgs &&pushFuncArgs, int32_t numResults, std::string &outErr, int32_t (*traceback)(lua_State *) = nullptr, void (*pushArgErrorHandler)(lua_State *, StatusCode) = nullptr)
+		{
+			if constexpr(std::is_pointer_v<std::remove_cvref_t<TPushFuncArgs>>) {
+				if(pushFuncArgs == nullptr)
+					return protected_call(lua, PushArgsCallback {}, numResults, outErr, traceback, pushArgErrorHandler);
+			}
+			return protected_call(lua, PushArgsCallback {pushFuncArgs}, numResults, outErr, traceback, pushArgErrorHandler);
+		}
 		DLLLUA StatusCode ProtectedCall(lua_State *lua, const std::function<StatusCode(lua_State *)> &pushFuncArgs, int32_t numResults, std::string &outErr, int32_t (*traceback)(lua_State *) = nullptr, void (*pushArgErrorHandler)(lua_State *, StatusCode) = nullptr);
 		DLLLUA StatusCode ProtectedCall(lua_State *lua, int32_t nargs, int32_t nresults, std::string &outErr, int32_t (*traceback)(lua_State *) = nullptr, void (*pushArgErrorHandler)(lua_State *, StatusCode) = nullptr);
 		// Creates a new table and pushes it onto the stack.
@@ -134,6 +157,21 @@ export {
 		{
 			luabind::object(lua, value).push(lua);
 		}
+		// Used by the type checks of LUA_REGISTER_TYPE. Reads the instance pointer directly from the luabind object instead of
+		// constructing a luabind::object and running the converter matching. Exact types are matched by their class id,
+		// derived classes are resolved through luabind's cast graph.
+		// Returns nullptr if the value is not a non-const instance of T.
+		template<typename T>
+		T *get_registered_instance(lua_State *l, int n)
+		{
+			auto *obj = luabind::detail::get_instance(l, n);
+			if(obj == nullptr || obj->is_const())
+				return nullptr;
+			auto instance = obj->get_instance(luabind::detail::registered_class<T>::id);
+			if(instance.second < 0)
+				return nullptr;
+			return static_cast<T *>(instance.first);
+		}
 		template<class T>
 		void PushNumber(lua_State *lua, T t);
 		template<class T>
@@ -152,6 +190,8 @@ export {
 		}
 		DLLLUA void PushBool(lua_State *lua, bool b);
 		DLLLUA void PushCFunction(lua_State *lua, lua_CFunction f);
+		// Same as PushCFunction, but the function object is created only once and cached in the registry
+		DLLLUA void push_cached_c_function(lua_State *lua, lua_CFunction f);
 		DLLLUA void PushInt(lua_State *lua, ptrdiff_t i);
 		DLLLUA void PushNil(lua_State *lua);
 		DLLLUA void PushNumber(lua_State *lua, float f);
@@ -196,7 +236,16 @@ export {
 		DLLLUA void Error(lua_State *lua, const std::string &err);
 		DLLLUA void Register(lua_State *lua, const char *name, lua_CFunction f);
 		DLLLUA void RegisterEnum(lua_State *l, const std::string &name, int32_t val);
+		template<typename T>
+		struct LibraryValue {
+			const char *name;
+			T value;
+		};
+		using LibraryEnum = LibraryValue<lua_Integer>;
 		DLLLUA std::shared_ptr<luabind::module_> RegisterLibrary(lua_State *lua, const std::string &name, const std::vector<luaL_Reg> &functions);
+		// Registers the functions (and optionally enums) without copying them. The library table is pre-sized for all entries.
+		// Can be used with constexpr registration tables. A terminating {nullptr, nullptr} entry is optional.
+		DLLLUA std::shared_ptr<luabind::module_> register_library(lua_State *lua, const std::string &name, std::span<const luaL_Reg> functions, std::span<const LibraryEnum> enums = {});
 		// Creates a reference of the object at the stack top and pops it
 		DLLLUA int32_t CreateReference(lua_State *lua, int32_t t = RegistryIndex);
 		DLLLUA void ReleaseReference(lua_State *lua, int32_t ref, int32_t t = RegistryIndex);
@@ -219,6 +268,8 @@ export {
 		DLLLUA void SetTableValue(lua_State *lua, int32_t idx);
 		DLLLUA void GetTableValue(lua_State *lua, int32_t idx);
 		DLLLUA void SetRaw(lua_State *lua, int32_t idx);
+		// Returns true if the value is a table without a metatable, i.e. values can be assigned with SetRaw without bypassing any metamethods
+		DLLLUA bool is_plain_table(lua_State *lua, int32_t idx);
 		DLLLUA StatusCode GetProtectedTableValue(lua_State *lua, int32_t idx);
 		// If successful, the value will be the topmost element on the stack
 		DLLLUA StatusCode GetProtectedTableValue(lua_State *lua, int32_t idx, const std::string &key);
@@ -246,6 +297,9 @@ export {
 
 		DLLLUA StatusCode ExecuteFile(lua_State *lua, std::string &fInOut, std::string &outErr, int32_t (*traceback)(lua_State *) = nullptr, int32_t numRet = 0, void (*loadErrorHandler)(lua_State *, StatusCode) = nullptr);
 		DLLLUA StatusCode IncludeFile(lua_State *lua, std::string &fInOut, std::string &outErr, int32_t (*traceback)(lua_State *) = nullptr, int32_t numRet = 0, void (*loadErrorHandler)(lua_State *, StatusCode) = nullptr);
+		// Relative to the directory of the file that is currently being executed by the state
+		DLLLUA std::string GetIncludePath(lua_State *lua, const std::string &f);
+		// Without a state, the file that is currently being executed on the calling thread is used
 		DLLLUA std::string GetIncludePath();
 		DLLLUA std::string GetIncludePath(const std::string &f);
 		DLLLUA StatusCode RunString(lua_State *lua, const std::string &str, int32_t retCount, const std::string &chunkName, std::string &outErr, int32_t (*traceback)(lua_State *) = nullptr, void (*loadErrorHandler)(lua_State *, StatusCode) = nullptr);
@@ -256,24 +310,44 @@ export {
 		DLLLUA void PushWeakReference(const luabind::weak_ref &ref);
 		DLLLUA luabind::object WeakReferenceToObject(const luabind::weak_ref &ref);
 		DLLLUA void RegisterLibraryEnums(lua_State *l, const std::string &libName, const std::unordered_map<std::string, lua_Integer> &enums);
+		DLLLUA void RegisterLibraryEnums(lua_State *l, const std::string &libName, std::span<const LibraryEnum> enums);
 		template<typename T>
 		void RegisterLibraryValues(lua_State *l, const std::string &libName, const std::unordered_map<std::string, T> &values);
+		template<typename T>
+		void RegisterLibraryValues(lua_State *l, const std::string &libName, std::span<const LibraryValue<T>> values);
 
 		template<class T>
 		void RegisterLibraryValue(lua_State *l, const std::string &libName, const std::string &key, const T &val);
 
 		DLLLUA void GetField(lua_State *l, int32_t idx, const std::string &fieldName);
 
+		// Script loading state of a lua state. Every state has its own context, so separate states can load
+		// and execute scripts on different threads concurrently.
+		struct DLLLUA LoaderContext {
+			// Directories of the files that are currently being executed, the last one is the innermost
+			std::vector<std::string> includeStack;
+			// If not set, the process-wide setting is used (see set_precompiled_files_enabled)
+			std::optional<bool> precompiledFilesEnabled {};
+		};
+		// The context is created on first use and destroyed together with the state
+		DLLLUA LoaderContext &get_loader_context(lua_State *l);
+
+		// Process-wide default for all states that don't override it
 		DLLLUA void set_precompiled_files_enabled(bool bEnabled);
 		DLLLUA bool are_precompiled_files_enabled();
+		DLLLUA void set_precompiled_files_enabled(lua_State *l, bool bEnabled);
+		DLLLUA bool are_precompiled_files_enabled(lua_State *l);
 
-		DLLLUA void get_global_nested_library(lua_State *l, const std::string &name);
+		// Pushes the value at the given path (e.g. "game.ents") onto the stack, or nil if it doesn't exist.
+		// For repeated look-ups of the same path, use a GlobalPathHandle instead.
+		DLLLUA void get_global_nested_library(lua_State *l, const std::string_view &name);
 
 		// Expects a lua function at the top of the stack
 		DLLLUA bool compile_file(lua_State *l, const std::string &outPath);
 		DLLLUA std::string get_current_file(lua_State *l);
 
-		DLLLUA StatusCode LoadFile(lua_State *lua, std::string &fInOut, fsys::SearchFlags includeFlags = fsys::SearchFlags::All, fsys::SearchFlags excludeFlags = fsys::SearchFlags::None);
+		// 'mode' can be used to restrict loading to source files or precompiled files only
+		DLLLUA StatusCode LoadFile(lua_State *lua, std::string &fInOut, fsys::SearchFlags includeFlags = fsys::SearchFlags::All, fsys::SearchFlags excludeFlags = fsys::SearchFlags::None, LoadMode mode = LoadMode::Any);
 
 		DLLLUA void SetTableCFunction(lua_State *l, const char *tableName, const char *funcName, lua_CFunction f)
 		{
@@ -302,15 +376,40 @@ export {
 			throw std::runtime_error("No library '" + libName + " found!");
 		auto t = GetStackTop(l);
 		if(!IsNil(l, t)) {
+			luaL_checkstack(l, 2, nullptr);
+			auto raw = is_plain_table(l, t);
 			for(auto &pair : values) {
-				PushString(l, pair.first);
+				lua_pushlstring(l, pair.first.data(), pair.first.size());
 				Push<T>(l, pair.second);
-				SetTableValue(l, t);
+				if(raw)
+					SetRaw(l, t);
+				else
+					SetTableValue(l, t);
 			}
 		}
 		Pop(l, 1);
 	}
 
+	template<typename T>
+	void Lua::RegisterLibraryValues(lua_State *l, const std::string &libName, std::span<const LibraryValue<T>> values)
+	{
+		get_global_nested_library(l, libName);
+		if(Lua::IsNil(l, -1))
+			throw std::runtime_error("No library '" + libName + " found!");
+		auto t = GetStackTop(l);
+		luaL_checkstack(l, 2, nullptr);
+		auto raw = is_plain_table(l, t);
+		for(auto &val : values) {
+			lua_pushstring(l, val.name);
+			Push<T>(l, val.value);
+			if(raw)
+				SetRaw(l, t);
+			else
+				SetTableValue(l, t);
+		}
+		Pop(l, 1);
+	}
+
 	template<class T>
 	T Lua::CheckInt(lua_State *lua, int32_t idx)
 	{
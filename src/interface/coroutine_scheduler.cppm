@@ -0,0 +1,139 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:coroutine_scheduler;
+
+export import std.compat;
+
+export namespace Lua {
+	// Runs lua functions as coroutines on the thread of a lua state. Finished coroutine threads are kept in a pool
+	// and reused for new coroutines. Sleeping coroutines are kept in a hierarchical timer wheel (4 levels with
+	// 256 slots each, at a resolution of TICK_DURATION), so neither scheduling nor waking them up depends on the
+	// number of sleeping coroutines.
+	// A coroutine that yields through coroutine.yield (or lua_yield) is resumed again in the next update.
+	// The scheduler must only be used from the thread that runs the lua state.
+	class DLLLUA CoroutineScheduler {
+	  public:
+		using CoroutineId = uint64_t;
+		using Clock = std::chrono::steady_clock;
+		static constexpr CoroutineId INVALID_COROUTINE = 0;
+		static constexpr std::chrono::milliseconds TICK_DURATION {1};
+		static constexpr uint32_t DEFAULT_BATCH_SIZE = 1024;
+		static constexpr uint32_t DEFAULT_MAX_POOLED_THREADS = 1024;
+		struct DLLLUA Stats {
+			uint32_t live = 0;
+			uint32_t runnable = 0;
+			uint32_t sleeping = 0;
+			// Coroutines that are waiting for Wake
+			uint32_t suspended = 0;
+			uint32_t pooledThreads = 0;
+			uint64_t resumes = 0;
+			uint64_t completed = 0;
+			uint64_t errors = 0;
+			// Number of coroutines that have been started on a recycled thread
+			uint64_t threadsReused = 0;
+		};
+		using ErrorHandler = std::function<void(CoroutineId, const std::string &)>;
+
+		CoroutineScheduler(lua_State *l, uint32_t maxPooledThreads = DEFAULT_MAX_POOLED_THREADS);
+		CoroutineScheduler(const CoroutineScheduler &) = delete;
+		CoroutineScheduler &operator=(const CoroutineScheduler &) = delete;
+		~CoroutineScheduler();
+
+		// Expects the function followed by 'numArgs' arguments on the stack of 'l' (which must be the scheduler's state or one of its threads) and pops them.
+		// The coroutine is started in the next update.
+		CoroutineId Spawn(lua_State *l, int32_t numArgs = 0);
+		// Same as Spawn, but the coroutine is started after the delay has passed
+		CoroutineId SpawnDelayed(lua_State *l, std::chrono::milliseconds delay, int32_t numArgs = 0);
+		// Makes a sleeping or suspended coroutine runnable
+		bool Wake(CoroutineId id);
+		// Removes the coroutine. Running coroutines can't be killed.
+		bool Kill(CoroutineId id);
+		bool IsAlive(CoroutineId id) const;
+
+		// Has to be used as the return value of a lua C function that was called from a scheduled coroutine, e.g.:
+		// return scheduler.Wait(l, std::chrono::seconds {2});
+		int32_t Wait(lua_State *co, std::chrono::milliseconds duration);
+		// Like Wait, but the coroutine is only resumed by Wake
+		int32_t Suspend(lua_State *co);
+
+		// Advances the timer wheel to the current time and resumes up to 'maxResumes' runnable coroutines.
+		// Coroutines that don't fit into the batch stay runnable for the next update. Returns the number of resumed coroutines.
+		uint32_t Update(uint32_t maxResumes = DEFAULT_BATCH_SIZE);
+		uint32_t Update(Clock::time_point now, uint32_t maxResumes = DEFAULT_BATCH_SIZE);
+
+		void SetErrorHandler(const ErrorHandler &errorHandler);
+		const Stats &GetStats() const;
+
+		// Lua C functions which can be registered in a library:
+		// wait(seconds): Suspends the calling coroutine for the given duration
+		static int32_t LuaWait(lua_State *l);
+		// suspend(): Suspends the calling coroutine until it is woken up by Wake
+		static int32_t LuaSuspend(lua_State *l);
+		// Returns the scheduler of the lua state, or nullptr if there is none
+		static CoroutineScheduler *Get(lua_State *l);
+	  private:
+		static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+		static constexpr uint32_t WHEEL_LEVELS = 4;
+		static constexpr uint32_t WHEEL_BITS = 8;
+		static constexpr uint32_t WHEEL_SLOTS = 1 << WHEEL_BITS;
+		enum class State : uint8_t {
+			Free = 0,
+			Runnable,
+			Running,
+			Sleeping,
+			Suspended,
+		};
+		struct Entry {
+			lua_State *thread = nullptr;
+			int32_t threadRef = LUA_NOREF;
+			uint32_t generation = 1;
+			State state = State::Free;
+			// Number of arguments for the next resume
+			int32_t numArgs = 0;
+			uint64_t wakeTick = 0;
+			// Timer wheel list links
+			uint32_t slot = INVALID_INDEX;
+			uint32_t prev = INVALID_INDEX;
+			uint32_t next = INVALID_INDEX;
+		};
+		struct PooledThread {
+			lua_State *thread = nullptr;
+			int32_t threadRef = LUA_NOREF;
+		};
+		static CoroutineId GetId(uint32_t index, uint32_t generation);
+		Entry *FindEntry(CoroutineId id);
+		const Entry *FindEntry(CoroutineId id) const;
+		uint32_t FindRunningEntry(lua_State *co) const;
+		uint32_t Create(lua_State *l, int32_t numArgs);
+		uint64_t GetWakeTick(std::chrono::milliseconds delay) const;
+		void FreeEntry(uint32_t index, bool recycleThread);
+		void SetState(Entry &entry, State state);
+		void MakeRunnable(uint32_t index);
+		void Resume(uint32_t index);
+
+		void ScheduleTimer(uint32_t index, uint64_t wakeTick);
+		void UnlinkTimer(uint32_t index);
+		// Re-distributes the timers of the current slot of the given level to the lower levels and returns the slot index
+		uint32_t Cascade(uint32_t level);
+		void AdvanceTick();
+
+		lua_State *m_state = nullptr;
+		uint32_t m_maxPooledThreads = DEFAULT_MAX_POOLED_THREADS;
+		std::vector<Entry> m_entries;
+		std::vector<uint32_t> m_freeEntries;
+		std::vector<PooledThread> m_threadPool;
+		// Pairs of entry index and generation. Killed coroutines are skipped when they're popped.
+		std::deque<std::pair<uint32_t, uint32_t>> m_runQueue;
+		std::array<uint32_t, WHEEL_LEVELS * WHEEL_SLOTS> m_wheel;
+		uint64_t m_currentTick = 0;
+		Clock::time_point m_startTime {};
+		uint32_t m_runningIndex = INVALID_INDEX;
+		ErrorHandler m_errorHandler = nullptr;
+		Stats m_stats {};
+	};
+};
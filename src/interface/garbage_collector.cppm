@@ -0,0 +1,68 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:garbage_collector;
+
+export import std.compat;
+
+export namespace Lua {
+	// Runs incremental garbage collection steps within a fixed time budget (e.g. once per frame), instead of
+	// full collections. The pause and step multiplier of the collector are adapted to the allocation rate:
+	// If the heap keeps growing while the budget is exhausted, the collector is made more aggressive, and it
+	// is relaxed again once the heap is stable.
+	// Must only be used from the thread that runs the lua state.
+	class DLLLUA GarbageCollector {
+	  public:
+		struct DLLLUA Settings {
+			// Work per lua_gc step call in KiB, 0 = smallest possible step
+			int32_t stepSizeKb = 0;
+			bool adaptive = true;
+			int32_t minPause = 100;
+			int32_t maxPause = 200;
+			int32_t minStepMultiplier = 200;
+			int32_t maxStepMultiplier = 1000;
+		};
+		struct DLLLUA Stats {
+			uint64_t steps = 0;
+			uint64_t completedCycles = 0;
+			// Time spent in the last call to Step
+			std::chrono::nanoseconds lastDuration {0};
+			// Longest single step of the last call to Step
+			std::chrono::nanoseconds lastMaxStepDuration {0};
+			// Moving average of the duration of a single step
+			std::chrono::nanoseconds averageStepDuration {0};
+			double lastFreedKb = 0.0;
+			double totalFreedKb = 0.0;
+			double heapSizeKb = 0.0;
+			// Smoothed change of the heap size (positive if the heap is growing)
+			double heapTrendKbPerSecond = 0.0;
+			// Smoothed rate at which memory is allocated between calls to Step
+			double allocationRateKbPerSecond = 0.0;
+			int32_t pause = 0;
+			int32_t stepMultiplier = 0;
+		};
+
+		GarbageCollector(lua_State *l);
+		// Runs collection steps until the budget has been used up or a collection cycle has been completed.
+		// Returns true if a cycle has been completed.
+		bool Step(std::chrono::microseconds budget);
+
+		void SetSettings(const Settings &settings);
+		const Settings &GetSettings() const;
+		const Stats &GetStats() const;
+	  private:
+		double GetHeapSizeKb() const;
+		void Adapt(bool budgetExhausted);
+		void ApplyParameters();
+
+		lua_State *m_state = nullptr;
+		Settings m_settings {};
+		Stats m_stats {};
+		std::chrono::steady_clock::time_point m_lastStepTime {};
+		double m_lastHeapSizeKb = 0.0;
+	};
+};
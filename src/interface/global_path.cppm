@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:global_path;
+
+export import std.compat;
+
+export namespace Lua {
+	// Handle to a global value, or a value in a (nested) global library, e.g. "game.ents.Foo".
+	// The path is resolved once into a registry reference to the parent table and an interned key,
+	// after which pushing the value only requires raw table look-ups and no allocations.
+	// Handles are re-resolved automatically after libraries have been (re-)registered or globals have been set
+	// through the Lua:: API, or if they are used with a different lua state. If a script replaces a table of the path
+	// directly, the handle has to be invalidated manually.
+	class DLLLUA GlobalPathHandle {
+	  public:
+		GlobalPathHandle(std::string path);
+		GlobalPathHandle(const GlobalPathHandle &) = delete;
+		GlobalPathHandle &operator=(const GlobalPathHandle &) = delete;
+		~GlobalPathHandle();
+		// Pushes the value onto the stack, or nil if the path could not be resolved. Errors raised by __index metamethods result in nil as well.
+		void Push(lua_State *l);
+		void Invalidate();
+		// Releases the registry references. Has no effect if the lua state has already been closed.
+		void Release();
+		const std::string &GetPath() const;
+
+		// Per-state generation, shared by all handles that have been resolved with the state. Destroyed together with the state.
+		struct StateInfo;
+		// Returns nullptr if no handle has been resolved with the state yet
+		static const std::shared_ptr<StateInfo> *FindStateInfo(lua_State *l);
+	  private:
+		static const std::shared_ptr<StateInfo> &GetStateInfo(lua_State *l);
+		bool Resolve(lua_State *l);
+		std::string m_path;
+		std::shared_ptr<StateInfo> m_stateInfo;
+		int32_t m_parentRef = LUA_NOREF;
+		int32_t m_keyRef = LUA_NOREF;
+		uint64_t m_generation = 0;
+	};
+
+	// Invalidates all global path handles of the lua state, they will be re-resolved on next use
+	DLLLUA void invalidate_global_path_handles(lua_State *l);
+	DLLLUA uint64_t get_global_path_generation(lua_State *l);
+};
@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:heap_snapshot;
+
+export import std.compat;
+
+export namespace lua {
+	// Compact record of all objects reachable from the registry of a lua state.
+	// Unlike lua::snapshot, the result is not stored in lua tables, so snapshots can be
+	// kept, written to disk and compared with each other.
+	struct DLLLUA HeapSnapshot {
+		static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+		enum class ObjectType : uint8_t {
+			Table = 0,
+			Function,
+			Thread,
+			UserData,
+			String,
+		};
+		struct DLLLUA Object {
+			uint64_t address = 0;
+			// Estimated size of the object itself in bytes, not including referenced objects
+			uint32_t size = 0;
+			// Edge through which the object was discovered first
+			uint32_t parentEdge = INVALID_INDEX;
+			ObjectType type = ObjectType::Table;
+		};
+		struct DLLLUA Edge {
+			// Index of the parent object, or INVALID_INDEX for the root
+			uint32_t parent = INVALID_INDEX;
+			uint32_t child = INVALID_INDEX;
+			// Index into the descriptions
+			uint32_t description = 0;
+		};
+		struct DLLLUA Retainer {
+			uint32_t objectIndex = INVALID_INDEX;
+			uint64_t retainedSize = 0;
+		};
+		static HeapSnapshot Capture(lua_State *l);
+		static std::optional<HeapSnapshot> Load(const std::string &path);
+		// Files are stored column by column (all addresses, then all sizes, etc.), including the retained sizes if they have been computed
+		// If writing fails, the partially written file is removed again
+		bool Save(const std::string &path) const;
+
+		// Builds the dominator tree of the object graph (Lengauer-Tarjan) and computes the retained size of every object,
+		// i.e. the memory that would be freed if the object was collected.
+		void ComputeRetainedSizes();
+		bool HasRetainedSizes() const;
+		// Returns the objects with the largest retained sizes, in descending order. Requires ComputeRetainedSizes.
+		std::vector<Retainer> GetTopRetainers(uint32_t count) const;
+		// One line per object with its retained and shallow size, type and path
+		std::string FormatTopRetainers(uint32_t count) const;
+
+		// Returns the chain of descriptions from the root to the object, e.g. "[registry].ents.[metatable]"
+		std::string GetPath(uint32_t objectIndex) const;
+		uint64_t GetTotalSize() const;
+
+		std::vector<Object> objects;
+		std::vector<Edge> edges;
+		std::vector<std::string> descriptions;
+		// Only available after ComputeRetainedSizes, one entry per object.
+		// The immediate dominator is INVALID_INDEX for objects that are only dominated by the root.
+		std::vector<uint32_t> immediateDominators;
+		std::vector<uint64_t> retainedSizes;
+	};
+
+	// Returns the indices of all objects in 'newer' that don't exist in 'older'. Since snapshots only
+	// contain reachable objects, these are all objects that were created in between and are still alive.
+	// Note: Objects are identified by their address, so an object that was collected and replaced by a
+	// new object of the same type at the same address will not be reported.
+	DLLLUA std::vector<uint32_t> diff_snapshots(const HeapSnapshot &older, const HeapSnapshot &newer);
+
+	DLLLUA const char *get_object_type_name(HeapSnapshot::ObjectType type);
+};
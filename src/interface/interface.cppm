@@ -7,39 +7,122 @@ module;
 
 export module pragma.lua:interface;
 
+export import :allocator;
+export import :buffer_bridge;
+export import :core;
+export import :coroutine_scheduler;
+export import :garbage_collector;
+export import :metrics;
+export import :profiler;
 export import luabind;
 export import std.compat;
 
 #undef RegisterLibrary
 
 export namespace Lua {
+	// Paths are compared case-insensitively after normalization. Look-ups do not allocate
+	// unless the path contains parent directory references ("..").
 	struct DLLLUA IncludeCache {
 		bool Contains(const std::string_view &path) const;
 		void Add(const std::string_view &path);
+		// Adds the path and keeps a registry reference to the value at the given stack index (e.g. the loaded chunk or its return value).
+		// Values are stored per lua state, a cache that is shared by several states keeps one reference for each of them.
+		void Add(lua_State *l, const std::string_view &path, int32_t idx);
+		// Pushes the value that was stored for the path by the same lua state onto the stack. Returns false (and pushes nothing) if there is none.
+		bool PushValue(lua_State *l, const std::string_view &path) const;
+		// Releases the registry references that belong to the lua state (or any of its threads). Must be called before the state is closed.
+		void Clear(lua_State *l);
+		// Removes all entries without releasing any references, e.g. after all lua states have been closed
 		void Clear();
 	  private:
-		std::unordered_set<uint32_t> m_cache;
+		struct PathHash {
+			using is_transparent = void;
+			size_t operator()(const std::string_view &path) const;
+		};
+		struct PathEqual {
+			using is_transparent = void;
+			bool operator()(const std::string_view &a, const std::string_view &b) const;
+		};
+		struct Reference {
+			int32_t reference = LUA_NOREF;
+			// Thread of the state the reference belongs to, and its registry to identify other threads of the same state
+			lua_State *state = nullptr;
+			const void *registry = nullptr;
+		};
+		struct Entry {
+			// Usually only a single one
+			std::vector<Reference> references;
+		};
+		template<typename TFunc>
+		auto Find(const std::string_view &path, const TFunc &func) const;
+		std::unordered_map<std::string, Entry, PathHash, PathEqual> m_cache;
 	};
 
+	// Includes the file only if it isn't in the cache yet. If 'cacheResult' is set, the first return value of the file is
+	// pushed onto the stack and kept in the cache, so subsequent includes push the cached value instead of reloading the file.
+	DLLLUA StatusCode IncludeFile(lua_State *lua, IncludeCache &cache, std::string &fInOut, std::string &outErr, bool cacheResult = false, int32_t (*traceback)(lua_State *) = nullptr, void (*loadErrorHandler)(lua_State *, StatusCode) = nullptr);
+
 	class DLLLUA Interface {
 	  public:
 		Interface();
 		virtual ~Interface();
 		const lua_State *GetState() const;
 		lua_State *GetState();
-		void Open();
+		// If the pool allocator is requested but not supported by the lua runtime, the default allocator is used instead
+		void Open(AllocatorType allocatorType = AllocatorType::Default);
+		// Returns nullptr if the state doesn't use the pool allocator
+		const PoolAllocator *GetAllocator() const;
 
 		void SetIdentifier(const std::string &identifier);
 		const std::string &GetIdentifier() const;
 		IncludeCache &GetIncludeCache();
+		Profiler &GetProfiler();
+		CoroutineScheduler &GetCoroutineScheduler();
+		GarbageCollector &GetGarbageCollector();
+		// Runs incremental garbage collection steps until the time budget has been used up, see GarbageCollector::Step
+		bool StepGarbageCollector(std::chrono::microseconds budget);
+		// Native memory that is shared with scripts, see BufferBridge
+		BufferBridge &GetBufferBridge();
+		// Returns nullptr if the library was built without metrics (see METRICS_ENABLED) or the state hasn't been opened yet
+		Metrics *GetMetrics();
 
 		// These need a const char* which exists for the lifetime of the lua state! (std::string won't work!)
 		luabind::module_ &RegisterLibrary(const char *name, const std::shared_ptr<luabind::module_> &mod);
 		luabind::module_ &RegisterLibrary(const char *name, const std::unordered_map<std::string, int (*)(lua_State *)> &functions = {});
+
+		// Defers the creation of a library until the global with its name is first accessed. 'populate' is called at that point
+		// and is expected to register the library (e.g. through RegisterLibrary); the name it receives exists for the lifetime of the lua state.
+		// Look-ups go through an __index metamethod on the globals table, which wraps any __index that was set before.
+		// Has no effect on accesses if a global with the same name already exists.
+		using PopulateLibraryCallback = std::function<void(Interface &, const char *)>;
+		void RegisterLazyLibrary(const std::string &name, const PopulateLibraryCallback &populate);
+		// Populates the library right away, if it hasn't been already. Returns false if no lazy library with this name was registered.
+		// Exceptions thrown by the populate callback are passed on to the caller (accesses from scripts raise a lua error instead).
+		bool MaterializeLibrary(const std::string_view &name);
+		bool IsLibraryMaterialized(const std::string_view &name) const;
+		// Names of all lazy libraries that have been populated, in the order they were populated in
+		const std::vector<std::string> &GetMaterializedLibraries() const;
 	  protected:
+		struct LazyLibrary {
+			PopulateLibraryCallback populate;
+			bool materialized = false;
+			// Set while the populate callback is running
+			bool populating = false;
+		};
+		void InstallLazyLibraryHandler();
+
 		lua_State *m_state = nullptr;
 		std::string m_identifier;
 		std::unordered_map<std::string, std::shared_ptr<luabind::module_>> m_modules;
+		std::map<std::string, LazyLibrary, std::less<>> m_lazyLibraries;
+		std::vector<std::string> m_materializedLibraries;
+		bool m_lazyLibraryHandlerInstalled = false;
 		IncludeCache m_luaIncludeCache;
+		std::unique_ptr<PoolAllocator> m_allocator;
+		std::unique_ptr<Profiler> m_profiler;
+		std::unique_ptr<CoroutineScheduler> m_coroutineScheduler;
+		std::unique_ptr<GarbageCollector> m_garbageCollector;
+		std::unique_ptr<BufferBridge> m_bufferBridge;
+		std::unique_ptr<Metrics> m_metrics;
 	};
 };
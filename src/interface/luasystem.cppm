@@ -4,6 +4,23 @@
 module;
 
 export module pragma.lua;
+export import :allocator;
+export import :array;
+export import :buffer_bridge;
+export import :bytecode_cache;
+export import :chunk_loader;
+export import :compiler;
 export import :core;
+export import :coroutine_scheduler;
+export import :garbage_collector;
+export import :global_path;
+export import :heap_snapshot;
 export import :interface;
+export import :metrics;
+export import :profiler;
+export import :script_bundle;
+export import :script_manifest;
+export import :serializer;
+export import :state_pool;
+export import :table_schema;
 export import :util;
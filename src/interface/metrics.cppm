@@ -0,0 +1,96 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:metrics;
+
+export import std.compat;
+
+export namespace Lua {
+	// Metrics are only recorded if the library was built with LUA_ENABLE_METRICS (CONFIG_ENABLE_LUA_METRICS),
+	// otherwise the instrumentation is compiled out entirely.
+#ifdef LUA_ENABLE_METRICS
+	constexpr bool METRICS_ENABLED = true;
+#else
+	constexpr bool METRICS_ENABLED = false;
+#endif
+
+	// Call counts, failure counts and latency histograms of the script loading and execution entry points of a lua state,
+	// bucketed by chunk name. Recording is lock-free and may happen from any thread.
+	class DLLLUA Metrics {
+	  public:
+		enum class Operation : uint8_t {
+			// LoadFile: Resolving and opening the file
+			FileLookup = 0,
+			// LoadFile: Reading the file contents
+			FileRead,
+			// LoadFile: Parsing / loading the chunk
+			Parse,
+			ExecuteFile,
+			ProtectedCall,
+			RunString,
+
+			Count,
+		};
+		// Bucket 0 contains latencies below 1us, bucket i latencies in [2^(i-1), 2^i) us, the last bucket everything above
+		static constexpr uint32_t HISTOGRAM_BUCKET_COUNT = 24;
+		// Chunks beyond this number are accumulated in a single bucket
+		static constexpr uint32_t MAX_CHUNK_COUNT = 1024;
+		static constexpr std::string_view OVERFLOW_CHUNK_NAME = "[other]";
+		struct DLLLUA OperationStats {
+			uint64_t calls = 0;
+			uint64_t failures = 0;
+			std::chrono::nanoseconds totalTime {0};
+			std::chrono::nanoseconds maxTime {0};
+			std::array<uint64_t, HISTOGRAM_BUCKET_COUNT> histogram {};
+		};
+		struct DLLLUA ChunkStats {
+			std::string chunkName;
+			std::array<OperationStats, static_cast<size_t>(Operation::Count)> operations {};
+		};
+
+		Metrics(lua_State *l);
+		Metrics(const Metrics &) = delete;
+		Metrics &operator=(const Metrics &) = delete;
+		~Metrics();
+		// Returns the metrics of the lua state, or nullptr if there are none
+		static Metrics *Get(lua_State *l);
+		static const char *GetOperationName(Operation op);
+
+		void Record(Operation op, const std::string_view &chunkName, std::chrono::nanoseconds duration, bool success);
+		// Only chunks with at least one recorded call are included
+		std::vector<ChunkStats> GetSnapshot() const;
+		void Reset();
+		// Pushes a table of the form {[chunkName] = {[operationName] = {calls, failures, totalTime, maxTime, histogram}}}, times are in seconds
+		void PushSnapshot(lua_State *l) const;
+		// Lua C function which pushes the snapshot of the calling state
+		static int32_t LuaGetSnapshot(lua_State *l);
+	  private:
+		struct OperationCounters {
+			std::atomic<uint64_t> calls = 0;
+			std::atomic<uint64_t> failures = 0;
+			std::atomic<uint64_t> totalTime = 0;
+			std::atomic<uint64_t> maxTime = 0;
+			std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKET_COUNT> histogram {};
+		};
+		struct Chunk {
+			Chunk(uint64_t hash, const std::string_view &name) : hash {hash}, name {name} {}
+			const uint64_t hash;
+			const std::string name;
+			std::array<OperationCounters, static_cast<size_t>(Operation::Count)> operations;
+		};
+		Chunk &GetChunk(const std::string_view &chunkName);
+
+		lua_State *m_state = nullptr;
+		// Open-addressing hash table, slots are claimed with a compare-and-swap
+		std::unique_ptr<std::atomic<Chunk *>[]> m_chunks;
+		std::atomic<uint32_t> m_chunkCount = 0;
+		// Longest distance between an entry and its home slot. Once the table is full, look-ups of new names
+		// give up after this many probes instead of scanning the entire table.
+		std::atomic<uint32_t> m_maxProbeLength = 0;
+		Chunk m_overflowChunk;
+	};
+};
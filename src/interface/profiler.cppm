@@ -0,0 +1,92 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:profiler;
+
+export import std.compat;
+
+export namespace Lua {
+	// Sampling CPU profiler based on a count hook. Every 'instructionCount' instructions the hook checks
+	// whether the sampling interval has elapsed, and if so, records the lua call stack into a preallocated
+	// buffer. The hook never aggregates samples itself, that happens in Update, Stop, GetLineStats and
+	// ExportCollapsedStacks. Samples that don't fit into the buffer are dropped, so Update should be called
+	// regularly (e.g. once per frame) while the profiler is running.
+	// The profiler must only be used from the thread that runs the lua state.
+	// Note: With LuaJIT, hooks are only invoked for interpreted code, time spent in compiled traces is
+	// attributed to the next interpreted instruction.
+	class DLLLUA Profiler {
+	  public:
+		// Deeper stacks keep their innermost and outermost frames, the frames in between are replaced with a single "[truncated]" frame
+		static constexpr uint32_t MAX_STACK_DEPTH = 32;
+		static constexpr size_t DEFAULT_SAMPLE_CAPACITY = 4096;
+		static constexpr std::chrono::microseconds DEFAULT_INTERVAL {1000};
+		static constexpr int32_t DEFAULT_INSTRUCTION_COUNT = 1000;
+		struct DLLLUA LineStats {
+			std::string source;
+			int32_t line = 0;
+			// Line where the function containing this line was defined
+			int32_t lineDefined = 0;
+			uint64_t samples = 0;
+		};
+
+		Profiler(size_t sampleCapacity = DEFAULT_SAMPLE_CAPACITY);
+		Profiler(const Profiler &) = delete;
+		Profiler &operator=(const Profiler &) = delete;
+		~Profiler();
+
+		bool Start(lua_State *l, std::chrono::microseconds interval = DEFAULT_INTERVAL, int32_t instructionCount = DEFAULT_INSTRUCTION_COUNT);
+		void Stop();
+		bool IsRunning() const;
+		// Discards all recorded samples
+		void Clear();
+		// Aggregates the buffered samples and makes room for new ones. Must not be called from within a hook of the state.
+		void Update();
+
+		uint64_t GetSampleCount() const;
+		// Number of samples that were discarded because the buffer was full
+		uint64_t GetDroppedSampleCount() const;
+		// Number of samples per source line, sorted by sample count (descending). Only the innermost frame of each sample is counted.
+		std::vector<LineStats> GetLineStats();
+		// Aggregated stacks in the collapsed format used by flamegraph tools ("frame;frame;frame count" per line)
+		std::string ExportCollapsedStacks();
+	  private:
+		static constexpr uint32_t TRUNCATED_SOURCE = std::numeric_limits<uint32_t>::max();
+		struct Frame {
+			// TRUNCATED_SOURCE for the frame that stands in for the omitted frames of a deep stack
+			uint32_t source = 0;
+			int32_t line = 0;
+			int32_t lineDefined = 0;
+		};
+		struct Sample {
+			uint32_t depth = 0;
+			std::array<Frame, MAX_STACK_DEPTH> frames;
+		};
+		static void Hook(lua_State *l, lua_Debug *ar);
+		void RecordSample(lua_State *l);
+		uint32_t GetSourceId(const std::string_view &source);
+		void Flush();
+		std::string GetFrameName(const Frame &frame) const;
+
+		lua_State *m_state = nullptr;
+		std::chrono::steady_clock::duration m_interval {};
+		std::chrono::steady_clock::time_point m_nextSample {};
+		std::vector<Sample> m_samples;
+		size_t m_sampleCount = 0;
+		uint64_t m_totalSampleCount = 0;
+		uint64_t m_droppedSampleCount = 0;
+
+		struct SourceHash {
+			using is_transparent = void;
+			size_t operator()(const std::string_view &source) const { return std::hash<std::string_view> {}(source); }
+		};
+		// Keyed by contents, since the source string of a collected chunk may be reused for a different source
+		std::unordered_map<std::string, uint32_t, SourceHash, std::equal_to<>> m_sourceIds;
+		std::vector<std::string> m_sources;
+		std::unordered_map<std::string, uint64_t> m_collapsedStacks;
+		std::map<std::tuple<uint32_t, int32_t, int32_t>, uint64_t> m_lineSamples;
+	};
+};
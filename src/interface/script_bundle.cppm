@@ -0,0 +1,82 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:script_bundle;
+
+export import :chunk_loader;
+export import :compiler;
+
+export namespace Lua {
+	// Single file containing the precompiled bytecode of many scripts. The file is memory-mapped, so
+	// scripts can be loaded from it without any file system access.
+	// Layout: Header, entries (sorted by path hash), path strings, bytecode.
+	// Paths are relative to SCRIPT_DIRECTORY, case-insensitive and without file extension.
+	class DLLLUA ScriptBundle {
+	  public:
+		static constexpr std::array<char, 4> MAGIC = {'L', 'B', 'D', 'L'};
+		static constexpr uint32_t VERSION = 1;
+		struct DLLLUA Script {
+			// Path relative to SCRIPT_DIRECTORY, e.g. "util/math.lua"
+			std::string path;
+			std::string bytecode;
+		};
+
+		// 'path' is a file system path, the file must not be located inside of an archive
+		static std::shared_ptr<ScriptBundle> Open(const std::string &path, std::string &outErr);
+		static bool Write(const std::string &path, const std::vector<Script> &scripts);
+
+		// Path relative to SCRIPT_DIRECTORY, with or without extension. The returned bytecode is valid for the lifetime of the bundle.
+		std::optional<std::string_view> Find(const std::string_view &path) const;
+		size_t GetScriptCount() const;
+		const std::string &GetPath() const;
+
+		// Mounted bundles are searched by LoadFile, after loose script files. Bundles that were mounted last are searched first.
+		// Loose script files are detected when the bundle is mounted. Files that are added afterwards only take precedence
+		// if the ScriptManifest is enabled (and has been updated), or once the bundle has been mounted again.
+		static void Mount(const std::shared_ptr<ScriptBundle> &bundle);
+		static void Unmount(const ScriptBundle &bundle);
+		static void UnmountAll();
+		// Keeps the bundle alive while the bytecode is in use
+		struct DLLLUA MountedScript {
+			std::shared_ptr<ScriptBundle> bundle;
+			std::string_view bytecode;
+			// True if a loose script file with the same path existed when the bundle was mounted
+			bool overridden = false;
+		};
+		static std::optional<MountedScript> FindMounted(const std::string_view &path);
+		static bool HasMountedBundles();
+	  private:
+		struct Header {
+			std::array<char, 4> magic;
+			uint32_t version;
+			uint32_t entryCount;
+			uint32_t reserved;
+		};
+		struct Entry {
+			uint64_t hash;
+			uint64_t dataOffset;
+			uint64_t dataSize;
+			uint32_t pathOffset;
+			uint32_t pathLength;
+		};
+		static_assert(sizeof(Header) == 16 && sizeof(Entry) == 32);
+		static std::string GetKey(const std::string_view &path);
+		static uint64_t GetHash(const std::string_view &key);
+		ScriptBundle() = default;
+		std::string_view GetEntryPath(const Entry &entry) const;
+		std::optional<size_t> FindIndexByKey(const std::string_view &key, uint64_t hash) const;
+		std::optional<std::string_view> FindByKey(const std::string_view &key, uint64_t hash) const;
+
+		std::string m_path;
+		std::unique_ptr<MappedFile> m_file;
+		std::span<const Entry> m_entries;
+	};
+
+	// Compiles all lua-files in the given directory (see BatchCompileInfo) and writes their stripped bytecode into a bundle.
+	// Returns false if any of the files failed to compile, or if the bundle couldn't be written.
+	DLLLUA bool create_script_bundle(const BatchCompileInfo &info, const std::string &outPath, std::vector<CompileResult> *outResults = nullptr);
+};
@@ -0,0 +1,55 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:script_manifest;
+
+export import std.compat;
+
+export namespace Lua {
+	// Index of the script files (source and precompiled) in the script directory.
+	// Each directory is indexed once on first access. Look-ups are case-insensitive.
+	// Disabled by default: While it is enabled, new files are only picked up through Update, and the
+	// indexed directories have to be invalidated (or the manifest cleared) if the mounted file systems change.
+	class DLLLUA ScriptManifest {
+	  public:
+		struct DLLLUA Script {
+			// File name without extension
+			std::string name;
+			bool hasSource = false;
+			bool hasPrecompiled = false;
+		};
+		static ScriptManifest &Get();
+
+		// Path is relative to SCRIPT_DIRECTORY, with or without extension. Returns an empty value if the script is not indexed.
+		std::optional<Script> FindScript(const std::string_view &path);
+		// Returns the file names of the best variant of every script in the directory (relative to SCRIPT_DIRECTORY)
+		std::vector<std::string> GetScriptFiles(const std::string_view &dir, bool includePrecompiled);
+
+		// Re-checks a single script file and updates its entry if the directory has already been indexed
+		void Update(const std::string_view &path);
+		void InvalidateDirectory(const std::string_view &dir);
+		void Clear();
+
+		void SetEnabled(bool enabled);
+		bool IsEnabled() const;
+	  private:
+		ScriptManifest() = default;
+		struct DirectoryIndex {
+			std::vector<Script> scripts;
+			std::unordered_map<std::string, size_t> nameToIndex;
+		};
+		// Normalized path relative to SCRIPT_DIRECTORY with a trailing slash, in its original case
+		static std::string GetDirectoryPath(const std::string_view &dir);
+		static void SplitPath(const std::string_view &path, std::string &outDir, std::string &outName);
+		static void BuildIndex(const std::string &dir, DirectoryIndex &outIndex);
+		std::shared_ptr<DirectoryIndex> GetIndex(const std::string &dir);
+
+		mutable std::shared_mutex m_mutex;
+		std::unordered_map<std::string, std::shared_ptr<DirectoryIndex>> m_directories;
+		std::atomic<bool> m_enabled = false;
+	};
+};
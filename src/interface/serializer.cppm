@@ -0,0 +1,58 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:serializer;
+
+export import std.compat;
+
+export namespace Lua {
+	// Encodes lua values into a compact binary format, which can be decoded in any other lua state.
+	// Supported are nil, booleans, numbers, strings and tables (including cycles and tables that are referenced
+	// multiple times), as well as userdata types which have been registered with RegisterUserDataType.
+	// Metatables are not serialized. The encoded data is written into an internal buffer, which is reused by
+	// subsequent calls, so an instance should be kept around instead of being created for every call.
+	class DLLLUA ValueSerializer {
+	  public:
+		static constexpr uint32_t MAX_DEPTH = 200;
+		// Appends the encoded userdata at the given stack index to 'outData'. Returns false if the value can't be encoded.
+		using EncodeUserData = std::function<bool(lua_State *, int32_t, std::vector<uint8_t> &)>;
+		// Has to push exactly one value onto the stack on success
+		using DecodeUserData = std::function<bool(lua_State *, std::span<const uint8_t>)>;
+
+		// Userdata with the metatable registered under 'metatableName' (see luaL_newmetatable) is encoded with the given function.
+		// The encoding and the decoding serializer must have the same types registered, in the same order.
+		void RegisterUserDataType(const std::string &metatableName, const EncodeUserData &encode, const DecodeUserData &decode);
+
+		// Encodes 'count' values, starting at the given stack index. The returned data is valid until the next call to Encode.
+		// Returns an empty span on failure, see GetError.
+		std::span<const uint8_t> Encode(lua_State *l, int32_t idx, int32_t count = 1);
+		// Pushes the decoded values onto the stack and returns their number, or std::nullopt on failure (in which case nothing is pushed)
+		std::optional<int32_t> Decode(lua_State *l, std::span<const uint8_t> data);
+		const std::string &GetError() const;
+	  private:
+		struct UserDataType {
+			std::string metatableName;
+			EncodeUserData encode;
+			DecodeUserData decode;
+		};
+		bool EncodeValue(lua_State *l, int32_t idx, uint32_t depth);
+		bool EncodeTable(lua_State *l, int32_t idx, uint32_t depth);
+		bool EncodeUserDataValue(lua_State *l, int32_t idx);
+		bool DecodeValue(lua_State *l, int32_t tablesIdx, uint32_t depth);
+		bool DecodeTable(lua_State *l, int32_t tablesIdx, uint32_t depth);
+		bool SetError(std::string err);
+
+		std::vector<UserDataType> m_userDataTypes;
+		std::vector<uint8_t> m_buffer;
+		// Tables that have already been encoded, mapped to the order in which they were encountered
+		std::unordered_map<const void *, uint32_t> m_tableIds;
+		std::span<const uint8_t> m_readData;
+		size_t m_readOffset = 0;
+		uint32_t m_numDecodedTables = 0;
+		std::string m_error;
+	};
+};
@@ -0,0 +1,135 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:state_pool;
+
+export import :interface;
+
+export namespace Lua {
+	// Values that can be passed between the calling thread and the pool states
+	using JobValue = std::variant<std::monostate, bool, lua_Number, std::string>;
+
+	struct DLLLUA Job {
+		// Name of a global function, can be a nested path (e.g. "ai.think")
+		std::string functionName;
+		std::vector<JobValue> args;
+		int32_t numResults = LUA_MULTRET;
+	};
+
+	struct DLLLUA JobResult {
+		StatusCode status = StatusCode::Ok;
+		std::string error;
+		// Return values that can't be represented as a JobValue are returned as nil
+		std::vector<JobValue> values;
+	};
+
+	// Bounded lock-free multi-producer/multi-consumer queue (D. Vyukov).
+	// The capacity is rounded up to the next power of two.
+	template<typename T>
+	class MpmcQueue {
+	  public:
+		MpmcQueue(size_t capacity) : m_cells(std::bit_ceil(std::max<size_t>(capacity, 2))), m_mask {m_cells.size() - 1}
+		{
+			for(size_t i = 0; i < m_cells.size(); ++i)
+				m_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		bool TryPush(T value)
+		{
+			Cell *cell;
+			auto pos = m_enqueuePos.load(std::memory_order_relaxed);
+			for(;;) {
+				cell = &m_cells[pos & m_mask];
+				auto seq = cell->sequence.load(std::memory_order_acquire);
+				auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+				if(diff == 0) {
+					if(m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if(diff < 0)
+					return false; // Full
+				else
+					pos = m_enqueuePos.load(std::memory_order_relaxed);
+			}
+			cell->value = std::move(value);
+			cell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+		bool TryPop(T &outValue)
+		{
+			Cell *cell;
+			auto pos = m_dequeuePos.load(std::memory_order_relaxed);
+			for(;;) {
+				cell = &m_cells[pos & m_mask];
+				auto seq = cell->sequence.load(std::memory_order_acquire);
+				auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+				if(diff == 0) {
+					if(m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if(diff < 0)
+					return false; // Empty
+				else
+					pos = m_dequeuePos.load(std::memory_order_relaxed);
+			}
+			outValue = std::move(cell->value);
+			cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+			return true;
+		}
+	  private:
+		struct Cell {
+			std::atomic<size_t> sequence;
+			T value;
+		};
+		std::vector<Cell> m_cells;
+		size_t m_mask;
+		alignas(64) std::atomic<size_t> m_enqueuePos = 0;
+		alignas(64) std::atomic<size_t> m_dequeuePos = 0;
+	};
+
+	// Owns a fixed number of lua interfaces, each of which is only ever used by its own worker thread.
+	// Jobs are distributed over per-worker queues; idle workers steal jobs from the queues of other workers.
+	class DLLLUA StatePool {
+	  public:
+		static constexpr size_t DEFAULT_QUEUE_CAPACITY = 1024;
+		// Called once on each worker thread after the interface has been opened
+		using InitCallback = std::function<void(Interface &, uint32_t workerIndex)>;
+		// 0 states = Use the number of hardware threads. If the init callback throws on any of the workers, all workers are
+		// shut down and the exception is rethrown.
+		StatePool(uint32_t numStates, const InitCallback &init, AllocatorType allocatorType = AllocatorType::Default, size_t queueCapacity = DEFAULT_QUEUE_CAPACITY);
+		~StatePool();
+		StatePool(const StatePool &) = delete;
+		StatePool &operator=(const StatePool &) = delete;
+
+		// Can be called from any thread. Blocks if all queues are full.
+		std::future<JobResult> Submit(Job job);
+		std::future<JobResult> Submit(std::string functionName, std::vector<JobValue> args = {});
+		uint32_t GetStateCount() const;
+	  private:
+		struct Task {
+			Job job;
+			std::promise<JobResult> promise;
+		};
+		struct Worker {
+			Worker(size_t queueCapacity) : queue {queueCapacity} {}
+			MpmcQueue<Task *> queue;
+			std::thread thread;
+		};
+		void Run(uint32_t workerIndex, const InitCallback &init, AllocatorType allocatorType, std::latch &initialized, std::exception_ptr &outInitError);
+		void Shutdown();
+		Task *PopTask(uint32_t workerIndex);
+
+		std::vector<std::unique_ptr<Worker>> m_workers;
+		std::atomic<uint32_t> m_nextWorker = 0;
+		std::atomic<uint32_t> m_pendingTasks = 0;
+		std::atomic<bool> m_running = true;
+	};
+
+	// Pushes the value onto the stack
+	DLLLUA void push_job_value(lua_State *l, const JobValue &value);
+	// Returns std::monostate for values that aren't nil, booleans, numbers or strings
+	DLLLUA JobValue to_job_value(lua_State *l, int32_t idx);
+};
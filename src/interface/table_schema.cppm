@@ -0,0 +1,244 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "lua_headers.hpp"
+
+export module pragma.lua:table_schema;
+
+export import :core;
+
+export namespace Lua {
+	// Declarative description of the fields of a lua table, which can be used to read an entire table
+	// (including nested tables and arrays) into a C++ object with a single protected call.
+	// Schemas are meant to be created once and can be shared between lua states and threads.
+	class DLLLUA TableSchema {
+	  public:
+		struct DLLLUA FieldError {
+			// e.g. "physics.shapes[2].radius"
+			std::string path;
+			std::string message;
+		};
+		struct Field;
+		struct ReadContext;
+		using ReadFunction = bool (*)(lua_State *, int32_t, void *, const Field &, ReadContext &);
+		struct DLLLUA Field {
+			std::string name;
+			// Type name used for error messages
+			const char *typeName = nullptr;
+			bool required = false;
+			// Schema for nested tables, or arrays of tables
+			const TableSchema *schema = nullptr;
+			ReadFunction read = nullptr;
+			void *(*resolve)(void *, const Field &) = nullptr;
+			std::function<void(void *)> applyDefault = nullptr;
+			// Member pointer or destination pointer
+			std::array<std::byte, sizeof(void *) * 2> target {};
+		};
+
+		TableSchema();
+		TableSchema(const TableSchema &) = delete;
+		TableSchema &operator=(const TableSchema &) = delete;
+
+		// Adds a field that is written to a member of the object passed to Read.
+		// Supported member types are bool, arithmetic types, std::string, std::vector of a supported type
+		// and structs (which require a nested schema).
+		template<typename TObject, typename TMember>
+		TableSchema &Add(std::string name, TMember TObject::*member, std::optional<TMember> defaultValue = {}, const TableSchema *schema = nullptr);
+		template<typename TObject, typename TMember>
+		TableSchema &AddRequired(std::string name, TMember TObject::*member, const TableSchema *schema = nullptr);
+		// Adds a field that is written to a fixed destination, independent of the object passed to Read
+		template<typename T>
+		TableSchema &Add(std::string name, T *destination, std::optional<T> defaultValue = {}, const TableSchema *schema = nullptr);
+
+		// Reads the table at the given stack index. Type errors and missing required fields are reported per field,
+		// the remaining fields are still read. Returns an error code if a lua error occurred (e.g. in an __index metamethod).
+		StatusCode Read(lua_State *l, int32_t idx, void *object, std::vector<FieldError> &outErrors) const;
+		template<typename TObject>
+		StatusCode Read(lua_State *l, int32_t idx, TObject &object, std::vector<FieldError> &outErrors) const
+		{
+			return Read(l, idx, static_cast<void *>(&object), outErrors);
+		}
+
+		// Releases the interned keys for the given state
+		void Release(lua_State *l) const;
+
+		const std::vector<Field> &GetFields() const;
+
+		struct DLLLUA ReadContext {
+			static constexpr size_t MAX_DEPTH = 32;
+			// Either a field or an array element
+			struct PathSegment {
+				const Field *field = nullptr;
+				size_t arrayIndex = 0;
+			};
+			std::vector<FieldError> *errors = nullptr;
+			std::array<PathSegment, MAX_DEPTH> path {};
+			size_t depth = 0;
+			void AddError(const std::string &message);
+		};
+		// Reads the table at the given absolute stack index into the object, must be called from within a protected call
+		void ReadTable(lua_State *l, int32_t tableIdx, void *object, ReadContext &context) const;
+	  private:
+		template<typename T>
+		static bool ReadValue(lua_State *l, int32_t idx, T &outValue, const Field &field, ReadContext &context);
+		template<typename T>
+		static bool ReadField(lua_State *l, int32_t idx, void *dst, const Field &field, ReadContext &context)
+		{
+			return ReadValue<T>(l, idx, *static_cast<T *>(dst), field, context);
+		}
+		template<typename T>
+		static const char *GetTypeName();
+		template<typename T>
+		Field &AddField(std::string name, const std::optional<T> &defaultValue, const TableSchema *schema);
+		void PushKeyTable(lua_State *l) const;
+
+		std::vector<Field> m_fields;
+		uint64_t m_id = 0;
+	};
+
+	template<typename T>
+	struct is_std_vector : std::false_type {};
+	template<typename T, typename TAlloc>
+	struct is_std_vector<std::vector<T, TAlloc>> : std::true_type {};
+};
+
+export {
+	template<typename T>
+	const char *Lua::TableSchema::GetTypeName()
+	{
+		if constexpr(std::is_same_v<T, bool>)
+			return "boolean";
+		else if constexpr(std::is_arithmetic_v<T>)
+			return "number";
+		else if constexpr(std::is_same_v<T, std::string>)
+			return "string";
+		else
+			return "table";
+	}
+
+	template<typename T>
+	bool Lua::TableSchema::ReadValue(lua_State *l, int32_t idx, T &outValue, const Field &field, ReadContext &context)
+	{
+		auto type = lua_type(l, idx);
+		if constexpr(std::is_same_v<T, bool>) {
+			if(type != LUA_TBOOLEAN)
+				return false;
+			outValue = lua_toboolean(l, idx) != 0;
+		}
+		else if constexpr(std::is_arithmetic_v<T>) {
+			if(type != LUA_TNUMBER)
+				return false;
+			// Converting values that aren't representable by T is undefined, so they're reported instead
+			auto v = lua_tonumber(l, idx);
+			if constexpr(std::is_integral_v<T>) {
+				// The upper bound is exclusive, since the maximum of 64-bit types isn't representable as a lua_Number
+				if(!(std::trunc(v) == v && v >= static_cast<lua_Number>(std::numeric_limits<T>::min()) && v < static_cast<lua_Number>(std::numeric_limits<T>::max() / 2 + 1) * 2)) {
+					context.AddError("integer in the range of " + std::to_string(std::numeric_limits<T>::min()) + " to " + std::to_string(std::numeric_limits<T>::max()) + " expected, got " + std::to_string(v));
+					return true;
+				}
+			}
+			else if constexpr(sizeof(T) < sizeof(lua_Number)) {
+				if(std::isfinite(v) && std::abs(v) > static_cast<lua_Number>(std::numeric_limits<T>::max())) {
+					context.AddError("number out of range");
+					return true;
+				}
+			}
+			outValue = static_cast<T>(v);
+		}
+		else if constexpr(std::is_same_v<T, std::string>) {
+			if(type != LUA_TSTRING)
+				return false;
+			size_t len;
+			auto *str = lua_tolstring(l, idx, &len);
+			outValue.assign(str, len);
+		}
+		else if constexpr(is_std_vector<T>::value) {
+			using TElement = typename T::value_type;
+			if(type != LUA_TTABLE)
+				return false;
+			if(context.depth >= ReadContext::MAX_DEPTH) {
+				context.AddError("maximum nesting depth exceeded");
+				return true;
+			}
+			auto n = lua_objlen(l, idx);
+			outValue.resize(n);
+			luaL_checkstack(l, 1, nullptr);
+			auto &segment = context.path[context.depth++];
+			segment.field = nullptr;
+			for(size_t i = 0; i < n; ++i) {
+				segment.arrayIndex = i + 1;
+				lua_rawgeti(l, idx, static_cast<int>(i + 1));
+				auto elementIdx = lua_gettop(l);
+				TElement value {};
+				if(ReadValue<TElement>(l, elementIdx, value, field, context))
+					outValue[i] = std::move(value);
+				else
+					context.AddError(std::string {GetTypeName<TElement>()} + " expected, got " + lua_typename(l, lua_type(l, elementIdx)));
+				lua_pop(l, 1);
+			}
+			--context.depth;
+		}
+		else {
+			static_assert(std::is_class_v<T>, "Unsupported field type");
+			if(type != LUA_TTABLE)
+				return false;
+			if(field.schema == nullptr) {
+				context.AddError("no schema for nested table");
+				return true;
+			}
+			field.schema->ReadTable(l, idx, &outValue, context);
+		}
+		return true;
+	}
+
+	template<typename T>
+	Lua::TableSchema::Field &Lua::TableSchema::AddField(std::string name, const std::optional<T> &defaultValue, const TableSchema *schema)
+	{
+		auto &field = m_fields.emplace_back();
+		field.name = std::move(name);
+		field.typeName = GetTypeName<T>();
+		field.schema = schema;
+		field.read = &ReadField<T>;
+		if(defaultValue.has_value())
+			field.applyDefault = [value = *defaultValue](void *dst) { *static_cast<T *>(dst) = value; };
+		return field;
+	}
+
+	template<typename TObject, typename TMember>
+	Lua::TableSchema &Lua::TableSchema::Add(std::string name, TMember TObject::*member, std::optional<TMember> defaultValue, const TableSchema *schema)
+	{
+		using TMemberPtr = TMember TObject::*;
+		static_assert(sizeof(TMemberPtr) <= sizeof(Field::target));
+		auto &field = AddField<TMember>(std::move(name), defaultValue, schema);
+		std::memcpy(field.target.data(), &member, sizeof(member));
+		field.resolve = [](void *object, const Field &field) -> void * {
+			TMemberPtr member;
+			std::memcpy(&member, field.target.data(), sizeof(member));
+			return &(static_cast<TObject *>(object)->*member);
+		};
+		return *this;
+	}
+
+	template<typename TObject, typename TMember>
+	Lua::TableSchema &Lua::TableSchema::AddRequired(std::string name, TMember TObject::*member, const TableSchema *schema)
+	{
+		Add(std::move(name), member, {}, schema);
+		m_fields.back().required = true;
+		return *this;
+	}
+
+	template<typename T>
+	Lua::TableSchema &Lua::TableSchema::Add(std::string name, T *destination, std::optional<T> defaultValue, const TableSchema *schema)
+	{
+		auto &field = AddField<T>(std::move(name), defaultValue, schema);
+		std::memcpy(field.target.data(), &destination, sizeof(destination));
+		field.resolve = [](void *, const Field &field) -> void * {
+			T *destination;
+			std::memcpy(&destination, field.target.data(), sizeof(destination));
+			return destination;
+		};
+		return *this;
+	}
+}
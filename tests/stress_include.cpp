@@ -0,0 +1,106 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+// Loads a tree of nested, relative includes on many lua states concurrently. Every state has its own
+// include stack, so relative paths must always resolve against the file that is executing on the same state.
+
+#include "lua_headers.hpp"
+
+import pragma.lua;
+
+static constexpr uint32_t THREAD_COUNT = 16;
+static constexpr uint32_t ITERATIONS = 200;
+static constexpr const char *SCRIPT_DIRECTORY = "stress_include/";
+static constexpr lua_Integer EXPECTED_RESULT = 122;
+
+static const std::pair<const char *, const char *> SCRIPTS[] = {
+  {"root.lua", "local a = include(\"level1/a.lua\")\nlocal b = include(\"level1/b.lua\")\nreturn a + b + include(\"root_value.lua\")\n"},
+  {"root_value.lua", "return 100\n"},
+  {"level1/a.lua", "return include(\"level2/c.lua\") * 2\n"},
+  {"level1/b.lua", "return include(\"level2/c.lua\") + 1\n"},
+  {"level1/level2/c.lua", "return 7\n"},
+};
+
+static int32_t include(lua_State *l)
+{
+	{
+		std::string path = luaL_checkstring(l, 1);
+		std::string err;
+		if(Lua::IncludeFile(l, path, err, nullptr, 1) == Lua::StatusCode::Ok)
+			return 1;
+		lua_pushstring(l, err.c_str());
+	}
+	// Raised outside of the scope, so the strings have been destroyed
+	return lua_error(l);
+}
+
+static bool write_scripts()
+{
+	for(auto &[name, source] : SCRIPTS) {
+		auto path = Lua::SCRIPT_DIRECTORY_SLASH + SCRIPT_DIRECTORY + name;
+		FileManager::CreatePath(ufile::get_path_from_filename(path).c_str());
+		auto f = FileManager::OpenFile<VFilePtrReal>(path.c_str(), "wb");
+		auto len = std::strlen(source);
+		if(f == nullptr || f->Write(source, len) != len)
+			return false;
+	}
+	return true;
+}
+
+static void remove_scripts()
+{
+	std::error_code ec;
+	std::filesystem::remove_all(std::filesystem::path {FileManager::GetProgramPath()} / Lua::SCRIPT_DIRECTORY / SCRIPT_DIRECTORY, ec);
+}
+
+// Returns an error message, or an empty string on success
+static std::string run_state(uint32_t threadIndex)
+{
+	auto *l = Lua::CreateState();
+	if(l == nullptr)
+		return "unable to create lua state";
+	lua_register(l, "include", include);
+	// Half of the states don't look for precompiled files, which must not affect the other states
+	if(threadIndex % 2 == 1)
+		Lua::set_precompiled_files_enabled(l, false);
+	std::string result;
+	for(uint32_t i = 0; i < ITERATIONS && result.empty(); ++i) {
+		std::string path = std::string {SCRIPT_DIRECTORY} + "root.lua";
+		std::string err;
+		if(Lua::IncludeFile(l, path, err, nullptr, 1) != Lua::StatusCode::Ok)
+			result = "iteration " + std::to_string(i) + ": " + err;
+		else if(lua_tointeger(l, -1) != EXPECTED_RESULT)
+			result = "iteration " + std::to_string(i) + ": unexpected result " + std::to_string(lua_tointeger(l, -1));
+		else if(!Lua::get_loader_context(l).includeStack.empty())
+			result = "iteration " + std::to_string(i) + ": include stack was not unwound";
+		lua_settop(l, 0);
+	}
+	Lua::CloseState(l);
+	return result;
+}
+
+int main()
+{
+	if(!write_scripts()) {
+		std::fputs("unable to write the test scripts\n", stderr);
+		remove_scripts();
+		return 1;
+	}
+	std::array<std::string, THREAD_COUNT> errors {};
+	std::vector<std::thread> threads;
+	threads.reserve(THREAD_COUNT);
+	for(uint32_t i = 0; i < THREAD_COUNT; ++i)
+		threads.emplace_back([i, &errors]() { errors[i] = run_state(i); });
+	for(auto &t : threads)
+		t.join();
+	remove_scripts();
+
+	auto success = true;
+	for(uint32_t i = 0; i < THREAD_COUNT; ++i) {
+		if(errors[i].empty())
+			continue;
+		std::fprintf(stderr, "state %u: %s\n", i, errors[i].c_str());
+		success = false;
+	}
+	return success ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: (c) 2025 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+// Compiles all lua-files below a sub-directory of the script directory to precompiled files, or into a script bundle.
+
+#include "lua_headers.hpp"
+
+import pragma.lua;
+
+static void print_usage()
+{
+	std::fputs("Usage: luasystem_compile [options] <path>\n"
+	           "  <path>               Sub-directory of the script directory to compile, including all of its sub-directories\n"
+	           "  --threads <n>        Number of worker threads (default: number of hardware threads)\n"
+	           "  --force              Also compile files whose precompiled file is up to date\n"
+	           "  --bundle <path>      Write the bytecode of all files into a script bundle instead\n"
+	           "  --quiet              Only print errors\n",
+	  stderr);
+}
+
+static const char *get_status_name(Lua::CompileResult::Status status)
+{
+	switch(status) {
+	case Lua::CompileResult::Status::Compiled:
+		return "compiled";
+	case Lua::CompileResult::Status::UpToDate:
+		return "up to date";
+	default:
+		return "failed";
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	Lua::BatchCompileInfo info {};
+	std::string bundlePath;
+	auto quiet = false;
+	auto hasPath = false;
+	for(int i = 1; i < argc; ++i) {
+		std::string_view arg = argv[i];
+		if(arg == "--force")
+			info.force = true;
+		else if(arg == "--quiet")
+			quiet = true;
+		else if(arg == "--threads" || arg == "--bundle") {
+			if(i + 1 >= argc) {
+				std::fprintf(stderr, "Missing value for %s\n", argv[i]);
+				return 1;
+			}
+			auto *value = argv[++i];
+			if(arg == "--threads")
+				info.threadCount = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			else
+				bundlePath = value;
+		}
+		else if(!arg.starts_with("--") && !hasPath) {
+			info.subPath = arg;
+			hasPath = true;
+		}
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+	if(!hasPath) {
+		print_usage();
+		return 1;
+	}
+
+	info.onFileProcessed = [quiet](const Lua::CompileResult &result) {
+		if(result.status == Lua::CompileResult::Status::Failed)
+			std::fprintf(stderr, "%s: %s\n", result.sourcePath.c_str(), result.error.c_str());
+		else if(!quiet)
+			std::printf("%s: %s\n", result.sourcePath.c_str(), get_status_name(result.status));
+	};
+
+	std::vector<Lua::CompileResult> results;
+	auto success = true;
+	if(!bundlePath.empty()) {
+		success = Lua::create_script_bundle(info, bundlePath, &results);
+		if(!success && std::none_of(results.begin(), results.end(), [](const Lua::CompileResult &result) { return result.status == Lua::CompileResult::Status::Failed; }))
+			std::fprintf(stderr, "Unable to write bundle '%s'\n", bundlePath.c_str());
+	}
+	else {
+		results = Lua::compile_files(info);
+		success = std::none_of(results.begin(), results.end(), [](const Lua::CompileResult &result) { return result.status == Lua::CompileResult::Status::Failed; });
+	}
+
+	if(!quiet) {
+		auto numFailed = std::count_if(results.begin(), results.end(), [](const Lua::CompileResult &result) { return result.status == Lua::CompileResult::Status::Failed; });
+		std::printf("%zu file(s) processed, %td failed\n", results.size(), numFailed);
+	}
+	return success ? 0 : 1;
+}